@@ -0,0 +1,217 @@
+#ifndef BATCH_PLOTS_H
+#define BATCH_PLOTS_H
+
+#include <TROOT.h>
+#include <TH1.h>
+#include <TCanvas.h>
+#include <TStyle.h>
+#include <TLegend.h>
+#include <TPad.h>
+#include <ROOT/TSeq.hxx>
+#include <ROOT/TProcessExecutor.hxx>
+
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+
+
+// ############################################
+// ## Look of the plots of one drawing macro ##
+// ############################################
+struct plot_style
+{
+  TString dir = "Plots/";        // where the PNGs go
+  int width = 1600, height = 1200;
+  double legend_x1 = 0.70;
+  int first_color = 2;           // colour of the first histogram, then +1
+  int first_integral_bin = 1;    // normalised to the integral from this bin
+};
+
+
+
+// ########################################################
+// ## A few histograms drawn on one canvas (not stacked) ##
+// ########################################################
+struct plot_job
+{
+  vector<TH1*> hists;
+  vector<TString> titles;
+  TString x_axis_title, title;
+  bool normalize = false;
+  double y_min = 0, y_max = 10000;
+};
+
+
+
+// #################################################################
+// ## One canvas and legend reused for all the plots of a process ##
+// #################################################################
+//
+// The histograms of a job are drawn from clones, deleted at the next
+// job, so the same job can be drawn again (PNG, then a PDF page) and the
+// histograms of the caller are never scaled.
+class plot_renderer
+{
+public:
+  plot_renderer(const plot_style &style) : style(style)
+  {
+    canvas = new TCanvas("batch_canvas", "batch_canvas", style.width, style.height);
+    legend = new TLegend(style.legend_x1, 0.80, 0.90, 0.90);
+  }
+
+
+  ~plot_renderer()
+  {
+    clear();
+    delete legend;
+    delete canvas;
+  }
+
+
+  // Draw a job on the canvas, false if it has no histogram
+  bool draw(const plot_job &job)
+  {
+    clear();
+    canvas->cd();
+    gStyle->SetOptStat(0);
+    canvas->SetGrid();
+    canvas->SetLogy(job.normalize==false);
+    legend->SetY1NDC(0.90 - 0.09*job.hists.size());
+
+    for (int i=0; i<job.hists.size(); i++) {
+      if (!job.hists[i]) { cout << "Requested object TH_[" << i << "] of " << job.title << " wasn't found!" << endl; continue; }
+      TH1 *hist = (TH1*)job.hists[i]->Clone(TString::Format("batch_hist_%d", i));
+      drawn.push_back(hist);
+
+      hist->SetMarkerStyle(20);
+      hist->SetMarkerSize(2);
+      hist->SetMarkerColor(i + style.first_color);
+      hist->SetLineColor(i + style.first_color);
+      hist->SetLineWidth(2);
+      double h_int = hist->Integral(style.first_integral_bin, hist->GetNbinsX());
+      if (job.normalize && h_int != 0) hist->Scale(1/h_int);
+
+      if (drawn.size()==1) {
+        hist->Draw("C");
+        hist->SetTitle(job.title);
+        hist->GetYaxis()->SetRangeUser(job.normalize ? 0 : job.y_min, job.y_max);
+        hist->GetYaxis()->SetTitle(job.normalize ? "#bf{Events norm to 1}" : "#bf{Events}");
+        hist->GetXaxis()->SetTitle(job.x_axis_title); }
+      else { hist->Draw("same C"); }
+      legend->AddEntry(hist, job.titles[i]); }
+
+    if (drawn.empty()) return false;
+    legend->Draw("same");
+    return true;
+  }
+
+
+  void print_png(const plot_job &job) { canvas->Print(style.dir + job.title + ".png"); }
+
+
+  // page_i of n_pages of a multi-page PDF: "(" opens it, ")" closes it
+  void print_pdf_page(TString pdf_path, int page_i, int n_pages, const plot_job &job)
+  {
+    if (n_pages > 1 && page_i == 0) pdf_path += "(";
+    else if (n_pages > 1 && page_i == n_pages-1) pdf_path += ")";
+    canvas->Print(pdf_path, "Title:" + job.title);
+  }
+
+
+private:
+  void clear()
+  {
+    legend->Clear();
+    canvas->Clear();
+    for (int i=0; i<drawn.size(); i++) { delete drawn[i]; }
+    drawn.clear();
+  }
+
+  plot_style style;
+  TCanvas *canvas;
+  TLegend *legend;
+  vector<TH1*> drawn;
+};
+
+
+
+// ##########################################################
+// ## Plots queued by a drawing macro and rendered at once ##
+// ##########################################################
+//
+// The PNGs are independent, so they are rendered by n_workers forked
+// processes (TProcessExecutor), each with its own reused canvas: ROOT
+// graphics rely on gPad and gStyle and can't be shared between threads.
+// The forked workers see the histograms of the parent as they were at
+// render(). The optional multi-page PDF, one page per plot in queue
+// order, is written by the parent after the PNGs. Rendering empties the
+// queue.
+class plot_batch
+{
+public:
+  plot_batch(const plot_style &style) : style(style) {}
+  ~plot_batch() { delete renderer; }
+
+
+  void add(const plot_job &job) { jobs.push_back(job); }
+
+
+  int size() const { return jobs.size(); }
+
+
+  void render(int n_workers = 1, TString pdf_path = "")
+  {
+    gROOT->SetBatch(kTRUE);
+    if (n_workers > 1 && jobs.size() > 1) {
+      ROOT::TProcessExecutor pool(min(n_workers, int(jobs.size())));
+      pool.Map([this](int job_i) { render_png(job_i); return 0; }, ROOT::TSeqI(jobs.size())); }
+    else for (int job_i=0; job_i<jobs.size(); job_i++) { render_png(job_i); }
+    cout << "Drawn " << jobs.size() << " plots into " << style.dir << " with " << max(n_workers, 1) << " worker processes" << endl;
+
+    if (pdf_path != "") {
+      plot_renderer &renderer = process_renderer();
+      int n_pages = 0;
+      for (int job_i=0; job_i<jobs.size(); job_i++) { if (has_hists(jobs[job_i])) n_pages++; }
+      for (int job_i=0, page_i=0; job_i<jobs.size(); job_i++) {
+        if (renderer.draw(jobs[job_i]) == false) continue;
+        renderer.print_pdf_page(pdf_path, page_i++, n_pages, jobs[job_i]); }
+      cout << "Drawn " << n_pages << " pages into " << pdf_path << endl; }
+    jobs.clear();
+
+    // The canvas and legend are not left for the destructor, which may run
+    // after ROOT has torn down its canvas list
+    delete renderer;
+    renderer = 0;
+  }
+
+
+private:
+  static bool has_hists(const plot_job &job)
+  {
+    for (int i=0; i<job.hists.size(); i++) { if (job.hists[i]) return true; }
+    return false;
+  }
+
+
+  void render_png(int job_i)
+  {
+    plot_renderer &renderer = process_renderer();
+    if (renderer.draw(jobs[job_i])) renderer.print_png(jobs[job_i]);
+  }
+
+
+  // One renderer per process, booked at its first plot
+  plot_renderer &process_renderer()
+  {
+    if (!renderer) renderer = new plot_renderer(style);
+    return *renderer;
+  }
+
+  plot_style style;
+  vector<plot_job> jobs;
+  plot_renderer *renderer = 0;
+};
+
+#endif
@@ -0,0 +1,265 @@
+#ifndef BINNED_TEMPLATE_FIT_H
+#define BINNED_TEMPLATE_FIT_H
+
+#include <TH1.h>
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+using namespace std;
+
+
+
+// ####################################################################
+// ## Binned Poisson likelihood fit of template fractions, no Minuit ##
+// ####################################################################
+//
+// Same model as TFractionFitter without the template statistics: the
+// prediction of bin i is N_data * sum_j p_j t_ji, with t_j the template j
+// normalised to unity over the fitted bins and p_j its fraction of the
+// data, each constrained to [lower, upper] like TFractionFitter::Constrain().
+// The negative log-likelihood sum_i (mu_i - d_i ln mu_i) is minimised by
+// Newton steps with the analytic gradient and Hessian, projected on the
+// constraints. All the per-bin work is done in flat loops over the bins
+// that the compiler vectorises. A fit starts from the fractions of the
+// previous converged one, unless start_from() sets the starting point of
+// the next fit; the scan and the toys set it for every fit, so their
+// results don't depend on the order of the fits.
+class binned_template_fitter
+{
+public:
+  binned_template_fitter(int n_templates, int n_bins)
+    : n_templates(n_templates), n_bins(n_bins),
+      templates(n_templates*n_bins, 0), data(n_bins, 0), mu(n_bins, 0), ratio(n_bins, 0),
+      lower(n_templates, 0), upper(n_templates, 1e10),
+      fractions(n_templates, 1./n_templates), errors(n_templates, 0), previous(n_templates, 1./n_templates),
+      gradient(n_templates, 0), hessian(n_templates*n_templates, 0), step(n_templates, 0), trial(n_templates, 0), is_free(n_templates, true) {}
+
+
+  // Template j from n_bins contents
+  void set_template(int j, const double *bins)
+  {
+    double *row = &templates[j*n_bins];
+    double integral = 0;
+    for (int i=0; i<n_bins; i++) { row[i] = bins[i]; integral += row[i]; }
+    if (integral > 0) for (int i=0; i<n_bins; i++) { row[i] /= integral; }
+  }
+
+  // Template j from the bins 1..n_bins of a histogram
+  void set_template(int j, const TH1 *hist)
+  {
+    for (int i=0; i<n_bins; i++) { data[i] = hist->GetBinContent(i+1); }
+    set_template(j, &data[0]);
+  }
+
+
+  // Same meaning as TFractionFitter::Constrain()
+  void constrain(int j, double low, double high) { lower[j] = low; upper[j] = high; }
+
+
+  // Start the next fit from the given fractions instead of the last result,
+  // for fits that must not depend on the ones done before
+  void start_from(const double *start_fractions)
+  {
+    for (int j=0; j<n_templates; j++) { previous[j] = start_fractions[j]; }
+  }
+
+
+  // Fit the bins 1..n_bins of data
+  int fit(const TH1 *data_hist, int max_iterations = 100)
+  {
+    for (int i=0; i<n_bins; i++) { data[i] = data_hist->GetBinContent(i+1); }
+    return fit(&data[0], max_iterations);
+  }
+
+
+  // Fit n_bins contents of data; 0: converged, 1: no convergence,
+  // 2: singular Hessian
+  int fit(const double *data_bins, int max_iterations = 100)
+  {
+    data_integral = 0;
+    for (int i=0; i<n_bins; i++) { data[i] = data_bins[i]; data_integral += data[i]; }
+    for (int j=0; j<n_templates; j++) { fractions[j] = min(max(previous[j], lower[j]), upper[j]); }
+
+    int status = 1;
+    double nll_now = nll(fractions);
+    for (int iteration=0; iteration<max_iterations; iteration++) {
+      derivatives(fractions);
+
+      // Newton step on the fractions not held at a constraint
+      for (int j=0; j<n_templates; j++) {
+        bool held = (fractions[j] <= lower[j] && gradient[j] > 0) || (fractions[j] >= upper[j] && gradient[j] < 0);
+        is_free[j] = !held; }
+      if (solve_free() == false) { status = 2; break; }
+
+      // Halve the step until the likelihood improves
+      double alpha = 1, nll_trial = nll_now;
+      for (int halving=0; halving<40; halving++) {
+        for (int j=0; j<n_templates; j++) { trial[j] = min(max(fractions[j] + alpha*step[j], lower[j]), upper[j]); }
+        nll_trial = nll(trial);
+        if (nll_trial <= nll_now) break;
+        alpha *= 0.5; }
+
+      // No step improved the likelihood even after all the halvings: the
+      // tiny last trial must not pass as convergence
+      if (nll_trial > nll_now) { status = 1; break; }
+
+      double max_change = 0;
+      for (int j=0; j<n_templates; j++) { max_change = max(max_change, fabs(trial[j] - fractions[j])); }
+      fractions.swap(trial);
+      nll_now = nll_trial;
+      if (max_change < 1e-9) { status = 0; break; } }
+
+    // Errors from the inverse Hessian at the minimum (error definition 0.5 of a NLL)
+    derivatives(fractions);
+    for (int j=0; j<n_templates; j++) { is_free[j] = true; }
+    vector<double> covariance;
+    if (invert_hessian(covariance)) {
+      for (int j=0; j<n_templates; j++) { errors[j] = sqrt(max(covariance[j*n_templates + j], 0.)); } }
+    else if (status == 0) status = 2;
+
+    if (status == 0) previous = fractions;
+    return status;
+  }
+
+
+  double fraction(int j) const { return fractions[j]; }
+  double error(int j) const { return errors[j]; }
+
+
+  // Likelihood chi2 of the last fit, over the bins with a prediction
+  double chisquare()
+  {
+    predict(fractions);
+    double chi2 = 0;
+    for (int i=0; i<n_bins; i++) {
+      if (mu[i] <= 0) continue;
+      chi2 += 2*(mu[i] - data[i]);
+      if (data[i] > 0) chi2 += 2*data[i]*log(data[i]/mu[i]); }
+    return chi2;
+  }
+
+  int ndf() const
+  {
+    int n_used = 0;
+    for (int i=0; i<n_bins; i++) { if (data[i] > 0) n_used++; }
+    return n_used - n_templates;
+  }
+
+
+  // Prediction of the last fit in the bins of a histogram
+  void fill_prediction(TH1 *hist)
+  {
+    predict(fractions);
+    hist->Reset();
+    for (int i=0; i<n_bins; i++) { hist->SetBinContent(i+1, mu[i]); }
+  }
+
+
+private:
+  void predict(const vector<double> &p)
+  {
+    for (int i=0; i<n_bins; i++) { mu[i] = 0; }
+    for (int j=0; j<n_templates; j++) {
+      const double *row = &templates[j*n_bins];
+      double scale = data_integral * p[j];
+      for (int i=0; i<n_bins; i++) { mu[i] += scale * row[i]; } }
+  }
+
+
+  double nll(const vector<double> &p)
+  {
+    predict(p);
+    double value = 0;
+    for (int i=0; i<n_bins; i++) {
+      if (data[i] > 0) value += mu[i] > 0 ? mu[i] - data[i]*log(mu[i]) : 1e30;
+      else value += mu[i]; }
+    return value;
+  }
+
+
+  // Gradient and Hessian of the NLL
+  void derivatives(const vector<double> &p)
+  {
+    predict(p);
+    for (int i=0; i<n_bins; i++) { ratio[i] = mu[i] > 0 ? data[i]/(mu[i]*mu[i]) : 0; }
+    for (int j=0; j<n_templates; j++) {
+      const double *row_j = &templates[j*n_bins];
+      double g = 0;
+      for (int i=0; i<n_bins; i++) { g += row_j[i] * (1 - ratio[i]*mu[i]); }
+      gradient[j] = data_integral * g;
+      for (int k=0; k<=j; k++) {
+        const double *row_k = &templates[k*n_bins];
+        double h = 0;
+        for (int i=0; i<n_bins; i++) { h += row_j[i] * row_k[i] * ratio[i]; }
+        hessian[j*n_templates + k] = hessian[k*n_templates + j] = data_integral * data_integral * h; } }
+  }
+
+
+  // Cholesky decomposition of the Hessian of the free fractions
+  bool cholesky(vector<double> &factor, vector<int> &index)
+  {
+    index.clear();
+    for (int j=0; j<n_templates; j++) { if (is_free[j]) index.push_back(j); }
+    int n = index.size();
+    factor.assign(n*n, 0);
+    for (int a=0; a<n; a++) {
+      for (int b=0; b<=a; b++) {
+        double sum = hessian[index[a]*n_templates + index[b]];
+        for (int c=0; c<b; c++) { sum -= factor[a*n + c] * factor[b*n + c]; }
+        if (a == b) {
+          if (sum <= 0) return false;
+          factor[a*n + a] = sqrt(sum); }
+        else factor[a*n + b] = sum / factor[b*n + b]; } }
+    return true;
+  }
+
+
+  // step = -H^-1 g over the free fractions, zero for the others
+  bool solve_free()
+  {
+    vector<int> index;
+    if (cholesky(factor, index) == false) return false;
+    int n = index.size();
+    vector<double> y(n);
+    for (int a=0; a<n; a++) {
+      double sum = -gradient[index[a]];
+      for (int c=0; c<a; c++) { sum -= factor[a*n + c] * y[c]; }
+      y[a] = sum / factor[a*n + a]; }
+    for (int j=0; j<n_templates; j++) { step[j] = 0; }
+    for (int a=n-1; a>=0; a--) {
+      double sum = y[a];
+      for (int c=a+1; c<n; c++) { sum -= factor[c*n + a] * step[index[c]]; }
+      step[index[a]] = sum / factor[a*n + a]; }
+    return true;
+  }
+
+
+  // Full inverse of the Hessian, column by column
+  bool invert_hessian(vector<double> &inverse)
+  {
+    vector<int> index;
+    if (cholesky(factor, index) == false) return false;
+    inverse.assign(n_templates*n_templates, 0);
+    vector<double> saved_gradient = gradient;
+    for (int column=0; column<n_templates; column++) {
+      for (int j=0; j<n_templates; j++) { gradient[j] = j==column ? -1 : 0; }
+      solve_free();
+      for (int j=0; j<n_templates; j++) { inverse[j*n_templates + column] = step[j]; } }
+    gradient = saved_gradient;
+    return true;
+  }
+
+
+  int n_templates, n_bins;
+  vector<double> templates;                 // [template][bin], normalised
+  vector<double> data, mu, ratio;           // [bin]
+  double data_integral = 0;
+  vector<double> lower, upper;
+  vector<double> fractions, errors, previous;
+  vector<double> gradient, hessian, step, trial, factor;
+  vector<bool> is_free;
+};
+
+#endif
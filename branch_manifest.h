@@ -0,0 +1,138 @@
+#ifndef BRANCH_MANIFEST_H
+#define BRANCH_MANIFEST_H
+
+#include <TTree.h>
+#include <TFile.h>
+#include <TBranch.h>
+
+#include <iostream>
+#include <vector>
+#include <functional>
+#include <algorithm>
+
+using namespace std;
+
+
+
+// #########################################################
+// ## The branches an analysis module reads from one tree ##
+// #########################################################
+//
+// Every branch a module needs is declared once with read(), which also
+// says where its value goes. attach() then switches off all the other
+// branches of the tree, sets the addresses and prepares a TTreeCache
+// holding exactly the declared branches, so that every GetEntry() is
+// served from a few large reads instead of many small ones.
+//
+// Branches declared with read_first() can be loaded alone with load_first(),
+// so that cheap cuts run before the heavy branches are deserialised with
+// load_rest(). Trees read with GetEntry() load everything as before.
+class branch_manifest
+{
+public:
+  // Declare a branch and the address its value is read into
+  template <typename T>
+  void read(TString name, T *address)
+  {
+    names.push_back(name);
+    setters.push_back([name, address](TTree *tree) { tree->SetBranchAddress(name, address); });
+    first_stage.push_back(false);
+  }
+
+
+  // Declare a branch needed by the cheap cuts, loaded by load_first()
+  template <typename T>
+  void read_first(TString name, T *address)
+  {
+    read(name, address);
+    first_stage.back() = true;
+  }
+
+
+  // Enable only the declared branches and train the cache on them
+  // for the entries [first, last) that are going to be read
+  void attach(TTree *tree, Long64_t first, Long64_t last)
+  {
+    attached_tree = tree;
+    tree->SetBranchStatus("*", 0);
+    Long64_t zip_bytes = 0;
+    first_branches.clear();
+    rest_branches.clear();
+    rest_bytes_per_entry = 0;
+    n_skipped = 0;
+    for (int i=0; i<names.size(); i++) {
+      TBranch *branch = tree->GetBranch(names[i]);
+      if (!branch) { cout << "Branch " << names[i] << " not found in " << tree->GetName() << endl; continue; }
+      tree->SetBranchStatus(names[i], 1);
+      setters[i](tree);
+      zip_bytes += branch->GetZipBytes();
+      if (first_stage[i]) first_branches.push_back(branch);
+      else {
+        rest_branches.push_back(branch);
+        rest_bytes_per_entry += double(branch->GetTotBytes()) / max(branch->GetEntries(), Long64_t(1)); } }
+
+    // Size the cache to hold one cluster of the declared branches
+    Long64_t n_entries = max(tree->GetEntries(), Long64_t(1));
+    TTree::TClusterIterator clusters = tree->GetClusterIterator(first);
+    Long64_t cluster_start = clusters();
+    Long64_t cluster_entries = max(clusters.GetNextEntry() - cluster_start, Long64_t(1));
+    Long64_t cache_size = zip_bytes / n_entries * cluster_entries * 5 / 4;
+    cache_size = min(max(cache_size, Long64_t(1000000)), Long64_t(200000000));
+
+    tree->SetCacheSize(cache_size);
+    for (int i=0; i<names.size(); i++) {
+      if (tree->GetBranch(names[i])) tree->AddBranchToCache(names[i], kTRUE); }
+    tree->SetCacheEntryRange(first, last);
+    tree->StopCacheLearningPhase();
+
+    bytes_at_attach = tree->GetCurrentFile()->GetBytesRead();
+  }
+
+
+  // Load the branches declared with read_first()
+  void load_first(Long64_t entry)
+  {
+    attached_tree->LoadTree(entry);
+    for (int i=0; i<first_branches.size(); i++) { first_branches[i]->GetEntry(entry); }
+  }
+
+
+  // Load the other branches of the entry given to load_first()
+  void load_rest(Long64_t entry)
+  {
+    for (int i=0; i<rest_branches.size(); i++) { rest_branches[i]->GetEntry(entry); }
+  }
+
+
+  // The entry given to load_first() failed the cheap cuts
+  void skip_rest() { n_skipped++; }
+
+
+  // Estimate of the uncompressed bytes of the other branches not
+  // deserialised thanks to skip_rest() since attach(), from their average
+  // size per entry. Not I/O saved: the TTreeCache still reads their baskets
+  Long64_t bytes_skipped() const { return Long64_t(rest_bytes_per_entry * n_skipped); }
+
+
+  // Bytes read from the file since attach()
+  Long64_t bytes_read() const
+  {
+    return attached_tree->GetCurrentFile()->GetBytesRead() - bytes_at_attach;
+  }
+
+
+  const vector<TString> &branches() const { return names; }
+
+
+private:
+  vector<TString> names;
+  vector<function<void(TTree*)>> setters;
+  vector<bool> first_stage;
+  vector<TBranch*> first_branches, rest_branches;
+  double rest_bytes_per_entry = 0;
+  Long64_t n_skipped = 0;
+  TTree *attached_tree = 0;
+  Long64_t bytes_at_attach = 0;
+};
+
+#endif
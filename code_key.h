@@ -0,0 +1,40 @@
+#ifndef CODE_KEY_H
+#define CODE_KEY_H
+
+#include <TString.h>
+#include <TSystem.h>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+using namespace std;
+
+
+
+// ##############################################################
+// ## Hash of the sources results saved between runs depend on ##
+// ##############################################################
+//
+// The sources are read from source_dir, the directory of the macro that
+// was compiled (gSystem->GetDirName(__FILE__)), not from the working
+// directory, so the standalone executables find them wherever they run.
+// extra names (e.g. variations) are hashed with them. A source that can't
+// be read is an error: results keyed without it would survive code edits.
+bool get_code_key(TString source_dir, const vector<TString> &sources, TString &key, const vector<TString> &extra = {})
+{
+  TString code;
+  for (int source_i=0; source_i<sources.size(); source_i++) {
+    TString source_path = source_dir + "/" + sources[source_i];
+    ifstream source(source_path.Data());
+    if (!source) { cout << "Can't read " << source_path << ", the sources have to stay where the macros were compiled" << endl; return false; }
+    stringstream content;
+    content << source.rdbuf();
+    code += sources[source_i] + "\n" + content.str().c_str(); }
+  for (int i=0; i<extra.size(); i++) { code += extra[i] + ","; }
+  key = to_string(code.Hash());
+  return true;
+}
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef EVENT_KINEMATICS_H
+#define EVENT_KINEMATICS_H
+
+#include <TMath.h>
+
+#include <vector>
+#include <cmath>
+
+using namespace std;
+
+
+
+// #################################################################
+// ## Jet and lepton kinematics of one event, structure of arrays ##
+// #################################################################
+//
+// Filled once per event from the ntuple branches (in GeV), with the
+// jet-jet and jet-lepton dR and jet+lepton invariant mass matrices computed
+// in one sweep. The buffers are kept between events and only grow with the
+// largest jet multiplicity seen, so that no event allocates. Leptons are
+// stored as [0] electron, [1] muon.
+class event_kinematics
+{
+public:
+  static const int n_leps = 2;
+
+  int n_jets = 0;
+  vector<double> jet_pt, jet_eta, jet_phi, jet_e, jet_px, jet_py, jet_pz;
+  double lep_pt[n_leps], lep_eta[n_leps], lep_phi[n_leps], lep_e[n_leps], lep_px[n_leps], lep_py[n_leps], lep_pz[n_leps];
+
+
+  // Copy the objects of an event and compute all the pair matrices
+  void fill(const vector<Float_t> &pt, const vector<Float_t> &eta, const vector<Float_t> &phi, const vector<Float_t> &e,
+            Float_t el_pt, Float_t el_eta, Float_t el_phi, Float_t el_e,
+            Float_t mu_pt, Float_t mu_eta, Float_t mu_phi, Float_t mu_e)
+  {
+    n_jets = pt.size();
+    resize(n_jets);
+
+    for (int i=0; i<n_jets; i++) {
+      jet_pt[i] = pt[i]*0.001;
+      jet_eta[i] = eta[i];
+      jet_phi[i] = phi[i];
+      jet_e[i] = e[i]*0.001; }
+    set_lepton(0, el_pt*0.001, el_eta, el_phi, el_e*0.001);
+    set_lepton(1, mu_pt*0.001, mu_eta, mu_phi, mu_e*0.001);
+
+    // Cartesian components, the only trigonometry of the event
+    for (int i=0; i<n_jets; i++) {
+      jet_px[i] = jet_pt[i] * cos(jet_phi[i]);
+      jet_py[i] = jet_pt[i] * sin(jet_phi[i]);
+      jet_pz[i] = jet_pt[i] * sinh(jet_eta[i]); }
+
+    // Jet-jet dR, row by row so that the inner loop vectorises
+    for (int i=0; i<n_jets; i++) {
+      double *row = &jj_dR[i*n_jets];
+      for (int j=0; j<n_jets; j++) { row[j] = delta_R(jet_eta[i], jet_phi[i], jet_eta[j], jet_phi[j]); } }
+
+    // Jet-lepton dR and invariant masses
+    for (int l=0; l<n_leps; l++) {
+      double *dR_row = &jl_dR[l*n_jets];
+      double *mass_row = &jl_mass[l*n_jets];
+      for (int i=0; i<n_jets; i++) {
+        dR_row[i] = delta_R(jet_eta[i], jet_phi[i], lep_eta[l], lep_phi[l]);
+        mass_row[i] = mass(jet_e[i] + lep_e[l], jet_px[i] + lep_px[l], jet_py[i] + lep_py[l], jet_pz[i] + lep_pz[l]); } }
+
+    ll_dR = delta_R(lep_eta[0], lep_phi[0], lep_eta[1], lep_phi[1]);
+  }
+
+
+  double dR_jet_jet(int i, int j) const { return jj_dR[i*n_jets + j]; }
+  double dR_jet_lep(int i, int l) const { return jl_dR[l*n_jets + i]; }
+  double mass_jet_lep(int i, int l) const { return jl_mass[l*n_jets + i]; }
+  const double *mass_jet_lep_row(int l) const { return &jl_mass[l*n_jets]; }
+  double dR_lep_lep() const { return ll_dR; }
+
+
+  // dR with phi wrapped into [0, pi]
+  static double delta_R(double eta_1st, double phi_1st, double eta_2nd, double phi_2nd)
+  {
+    double d_eta = eta_1st - eta_2nd;
+    double d_phi = fabs(phi_1st - phi_2nd);
+    d_phi = d_phi > TMath::Pi() ? TMath::TwoPi() - d_phi : d_phi;
+    return sqrt(d_eta*d_eta + d_phi*d_phi);
+  }
+
+
+  // Same sign convention as TLorentzVector::M()
+  static double mass(double e, double px, double py, double pz)
+  {
+    double mm = e*e - px*px - py*py - pz*pz;
+    return mm < 0 ? -sqrt(-mm) : sqrt(mm);
+  }
+
+
+private:
+  vector<double> jj_dR, jl_dR, jl_mass;
+  double ll_dR = 0;
+
+  void set_lepton(int l, double pt, double eta, double phi, double e)
+  {
+    lep_pt[l] = pt;
+    lep_eta[l] = eta;
+    lep_phi[l] = phi;
+    lep_e[l] = e;
+    lep_px[l] = pt * cos(phi);
+    lep_py[l] = pt * sin(phi);
+    lep_pz[l] = pt * sinh(eta);
+  }
+
+  // Grow only, resizing within the capacity doesn't allocate
+  void resize(int n)
+  {
+    jet_pt.resize(n); jet_eta.resize(n); jet_phi.resize(n); jet_e.resize(n);
+    jet_px.resize(n); jet_py.resize(n); jet_pz.resize(n);
+    jj_dR.resize(n*n);
+    jl_dR.resize(n_leps*n);
+    jl_mass.resize(n_leps*n);
+  }
+};
+
+#endif
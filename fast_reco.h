@@ -0,0 +1,64 @@
+#ifndef FAST_RECO_H
+#define FAST_RECO_H
+
+#include <vector>
+#include <algorithm>
+
+#include "mc_inputs.h"
+#include "event_kinematics.h"
+#include "reco_results.h"
+
+using namespace std;
+
+
+
+// #####################################################################
+// ## Analytic b-jet to top assignment of emu events, no minimisation ##
+// #####################################################################
+//
+// Every ordered pair of distinct jets (b of the electron, b of the muon)
+// among the leading n_jets gets the minimax m(lb) score,
+// max(m(e b1), m(mu b2)): for the right pairing both masses are below the
+// m(lb) endpoint, so the smallest larger mass picks it. The scores of all
+// the pairs are computed in one sweep over the jet+lepton mass rows of
+// event_kinematics. Results use the layout of the KLFitter ones, with the
+// score instead of a likelihood.
+class mlb_reco
+{
+public:
+  mlb_reco(int n_jets = 3) : n_jets(n_jets) {}
+
+
+  klf_result fit(const mc_event &ev, const event_kinematics &kin)
+  {
+    klf_result result;
+    int n = min(n_jets, kin.n_jets);
+    result.n_permutations = n*(n-1);
+    if (n < 2) return result;
+
+    // Scores of all the pairs, the diagonal (same jet twice) excluded after
+    const double *mass_el = kin.mass_jet_lep_row(0);
+    const double *mass_mu = kin.mass_jet_lep_row(1);
+    scores.resize(n*n);
+    for (int i=0; i<n; i++) {
+      double *row = &scores[i*n];
+      for (int j=0; j<n; j++) { row[j] = max(mass_el[i], mass_mu[j]); } }
+    for (int i=0; i<n; i++) { scores[i*n + i] = 1e10; }
+
+    int best = min_element(scores.begin(), scores.end()) - scores.begin();
+    result.b_index[0] = best / n;
+    result.b_index[1] = best % n;
+    result.score = scores[best];
+    result.mlb[0] = mass_el[result.b_index[0]];
+    result.mlb[1] = mass_mu[result.b_index[1]];
+    result.converged = true;
+    return result;
+  }
+
+
+private:
+  int n_jets;
+  vector<double> scores;
+};
+
+#endif
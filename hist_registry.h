@@ -0,0 +1,269 @@
+#ifndef HIST_REGISTRY_H
+#define HIST_REGISTRY_H
+
+#include <TH1.h>
+#include <TH1D.h>
+#include <TFile.h>
+
+#include <iostream>
+#include <vector>
+#include <functional>
+#include <memory>
+
+using namespace std;
+
+
+
+// ##############################################################
+// ## Histograms defined once: name, binning, region and value ##
+// ##############################################################
+//
+// values_t is whatever the macro computes per event (observables). Each
+// histogram gets the name it is written under, its binning, the selection
+// bits of its region (see selection_masks.h) and an expression adding zero
+// or more values of an event to fill with. The regions are the distinct
+// masks of all definitions, so an event is only offered to the histograms
+// of the regions it passes. Histograms marked with vary() also get a copy
+// per systematic variation, those marked with mc_only() are not booked in
+// the banks of data.
+template <typename values_t>
+class hist_registry
+{
+public:
+  typedef function<void(const values_t&, vector<double>&)> expression_t;
+
+  struct definition
+  {
+    TString name;
+    int n_bins;
+    double x_min, x_max;
+    UInt_t region;
+    expression_t value;
+    bool with_variations;
+    bool mc_only;
+  };
+
+
+  // Define a histogram, the name is the one written to the output file
+  void define(TString name, int n_bins, double x_min, double x_max, UInt_t region, expression_t value)
+  {
+    definition def = {name, n_bins, x_min, x_max, region, value, false, false};
+    int region_i = 0;
+    while (region_i < regions.size() && regions[region_i] != region) region_i++;
+    if (region_i == regions.size()) {
+      regions.push_back(region);
+      region_hists.push_back(vector<int>()); }
+    region_hists[region_i].push_back(definitions.size());
+    definitions.push_back(def);
+  }
+
+
+  // Fill the histograms whose name starts with the prefix for every variation
+  void vary(TString name_prefix)
+  {
+    for (int def_i=0; def_i<definitions.size(); def_i++) {
+      if (definitions[def_i].name.BeginsWith(name_prefix)) definitions[def_i].with_variations = true; }
+  }
+
+
+  // Histograms of truth quantities, by name prefix or by the selection
+  // bits of their region
+  void mc_only(TString name_prefix)
+  {
+    for (int def_i=0; def_i<definitions.size(); def_i++) {
+      if (definitions[def_i].name.BeginsWith(name_prefix)) definitions[def_i].mc_only = true; }
+  }
+
+  void mc_only(UInt_t region_bits)
+  {
+    for (int def_i=0; def_i<definitions.size(); def_i++) {
+      if (definitions[def_i].region & region_bits) definitions[def_i].mc_only = true; }
+  }
+
+
+  // True if an event with these selection bits enters at least one region
+  bool selects(UInt_t mask) const
+  {
+    for (int region_i=0; region_i<regions.size(); region_i++) {
+      if ((mask & regions[region_i]) == regions[region_i]) return true; }
+    return false;
+  }
+
+
+  vector<definition> definitions;
+  vector<UInt_t> regions;
+  vector<vector<int>> region_hists; // definitions of every region
+};
+
+
+
+// ###############################################################
+// ## One set of histograms of a registry, filled by one worker ##
+// ###############################################################
+//
+// Variation 0 is the nominal and books every histogram; the other variations
+// book only the histograms marked with vary(), so memory grows with the
+// number of varied histograms only. Banks of data book no mc_only()
+// histogram. Values are computed once per event and
+// histogram, then buffered per variation and added with FillN once a buffer
+// is full, instead of one Fill per value. Histograms are accumulated in double
+// precision; a worker fills one range at a time and the range sums are
+// added in range order (hist_shards.h), so the result doesn't depend on the
+// number of workers. A bank owns its histograms: it can be moved, e.g. into
+// a vector of worker banks, but not copied.
+template <typename values_t>
+class hist_bank
+{
+public:
+  hist_bank(const hist_registry<values_t> &registry, vector<TString> variations = {"nominal"}, int buffer_size = 256, bool is_data = false)
+    : registry(&registry), variations(variations), buffer_size(buffer_size)
+  {
+    int n_defs = registry.definitions.size();
+    hists.resize(variations.size());
+    x_buffers.resize(variations.size(), vector<vector<double>>(n_defs));
+    w_buffers.resize(variations.size(), vector<vector<double>>(n_defs));
+    for (int var_i=0; var_i<variations.size(); var_i++) {
+      hists[var_i].resize(n_defs);
+      for (int def_i=0; def_i<n_defs; def_i++) {
+        const typename hist_registry<values_t>::definition &def = registry.definitions[def_i];
+        if (var_i > 0 && def.with_variations == false) continue;
+        if (is_data && def.mc_only) continue;
+        TString name = hist_name(var_i, def_i);
+        hists[var_i][def_i].reset(new TH1D(name, name, def.n_bins, def.x_min, def.x_max));
+        x_buffers[var_i][def_i].reserve(buffer_size);
+        w_buffers[var_i][def_i].reserve(buffer_size); } }
+    values.reserve(buffer_size);
+    single_weight.resize(1);
+  }
+
+  hist_bank(hist_bank &&other) = default;
+  hist_bank &operator=(hist_bank &&other) = default;
+  hist_bank(const hist_bank &other) = delete;
+  hist_bank &operator=(const hist_bank &other) = delete;
+
+
+  // Offer an event to the nominal histograms of all the regions it passes
+  void fill(UInt_t mask, const values_t &event_values, double weight)
+  {
+    single_weight[0] = weight;
+    fill(mask, event_values, single_weight, 0);
+  }
+
+
+  // Offer an event to the histograms of the variations
+  // [first_variation, first_variation + weights.size()), one weight each
+  void fill(UInt_t mask, const values_t &event_values, const vector<double> &weights, int first_variation)
+  {
+    for (int region_i=0; region_i<registry->regions.size(); region_i++) {
+      UInt_t region = registry->regions[region_i];
+      if ((mask & region) != region) continue;
+
+      const vector<int> &region_hists = registry->region_hists[region_i];
+      for (int i=0; i<region_hists.size(); i++) {
+        int def_i = region_hists[i];
+        values.clear();
+        bool computed = false;
+
+        for (int w_i=0; w_i<weights.size(); w_i++) {
+          int var_i = first_variation + w_i;
+          if (hists[var_i][def_i] == 0) continue;
+          if (computed == false) { registry->definitions[def_i].value(event_values, values); computed = true; }
+
+          for (int value_i=0; value_i<values.size(); value_i++) {
+            x_buffers[var_i][def_i].push_back(values[value_i]);
+            w_buffers[var_i][def_i].push_back(weights[w_i]); }
+          if (x_buffers[var_i][def_i].size() >= buffer_size) flush(var_i, def_i); } } }
+  }
+
+
+  // Empty all the buffers into the histograms
+  void flush()
+  {
+    for (int var_i=0; var_i<hists.size(); var_i++) {
+      for (int def_i=0; def_i<hists[var_i].size(); def_i++) { flush(var_i, def_i); } }
+  }
+
+
+  // Add the histograms of another bank of the same registry and variations
+  void merge(hist_bank &other)
+  {
+    flush();
+    other.flush();
+    for (int var_i=0; var_i<hists.size(); var_i++) {
+      for (int def_i=0; def_i<hists[var_i].size(); def_i++) {
+        if (hists[var_i][def_i]) hists[var_i][def_i]->Add(other.hists[var_i][def_i].get()); } }
+  }
+
+
+  // Add the histograms written by write() to a directory, scaled
+  void add(TDirectory *dir, double scale = 1)
+  {
+    flush();
+    for (int var_i=0; var_i<hists.size(); var_i++) {
+      for (int def_i=0; def_i<hists[var_i].size(); def_i++) {
+        if (hists[var_i][def_i] == 0) continue;
+        TH1 *stored = (TH1*)dir->Get(hist_name(var_i, def_i));
+        if (!stored) { cout << "Histogram " << hist_name(var_i, def_i) << " not found in " << dir->GetName() << endl; continue; }
+        hists[var_i][def_i]->Add(stored, scale);
+        delete stored; } }
+  }
+
+
+  // Empty all the histograms
+  void reset()
+  {
+    flush();
+    for (int var_i=0; var_i<hists.size(); var_i++) {
+      for (int def_i=0; def_i<hists[var_i].size(); def_i++) { if (hists[var_i][def_i]) hists[var_i][def_i]->Reset(); } }
+  }
+
+
+  // Write all the histograms to the current directory, the nominal ones
+  // under their names and the others as <name>__<variation>
+  void write()
+  {
+    flush();
+    for (int var_i=0; var_i<hists.size(); var_i++) {
+      for (int def_i=0; def_i<hists[var_i].size(); def_i++) {
+        if (hists[var_i][def_i]) hists[var_i][def_i]->Write(hist_name(var_i, def_i)); } }
+  }
+
+
+  // Nominal histogram of the given name
+  TH1 *get(TString name) const
+  {
+    for (int def_i=0; def_i<hists[0].size(); def_i++) {
+      if (registry->definitions[def_i].name == name) return hists[0][def_i].get(); }
+    cout << "Histogram " << name << " is not defined" << endl;
+    return 0;
+  }
+
+
+  // True if an event with these selection bits enters at least one region
+  bool selects(UInt_t mask) const { return registry->selects(mask); }
+
+
+private:
+  TString hist_name(int var_i, int def_i) const
+  {
+    if (var_i == 0) return registry->definitions[def_i].name;
+    return registry->definitions[def_i].name + "__" + variations[var_i];
+  }
+
+  void flush(int var_i, int def_i)
+  {
+    if (x_buffers[var_i][def_i].empty()) return;
+    hists[var_i][def_i]->FillN(x_buffers[var_i][def_i].size(), &x_buffers[var_i][def_i][0], &w_buffers[var_i][def_i][0]);
+    x_buffers[var_i][def_i].clear();
+    w_buffers[var_i][def_i].clear();
+  }
+
+  const hist_registry<values_t> *registry;
+  vector<TString> variations;
+  int buffer_size;
+  vector<vector<unique_ptr<TH1>>> hists;            // [variation][definition]
+  vector<vector<vector<double>>> x_buffers, w_buffers; // [variation][definition][value]
+  vector<double> values, single_weight;
+};
+
+#endif
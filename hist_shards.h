@@ -0,0 +1,347 @@
+#ifndef HIST_SHARDS_H
+#define HIST_SHARDS_H
+
+#include <TTree.h>
+#include <TChain.h>
+#include <TFile.h>
+#include <TSystem.h>
+
+#include <iostream>
+#include <vector>
+#include <map>
+
+#include "mc_inputs.h"
+#include "hist_registry.h"
+#include "reco_results.h"
+
+using namespace std;
+
+
+
+// Events of the streamed trees of a shard and the reports of their
+// reconstruction, summed over its ranges, so the reports of a run cover the
+// reused and resumed ranges too
+struct shard_counts
+{
+  Long64_t NN_entries = 0;
+  reco_report reco;
+  klf_prescreen_stats prescreen;
+
+  void add(const shard_counts &other)
+  {
+    NN_entries += other.NN_entries;
+    reco.add(other.reco);
+    prescreen.add(other.prescreen);
+  }
+};
+
+
+
+// ##############################################################
+// ## Histograms and events of every ntuple, kept between runs ##
+// ##############################################################
+//
+// Works like selection_masks.h and klfitter_cache.h: every worker writes
+// the histograms of each range it processes to a range shard
+// (hist_shards/ranges/), with the streamed event trees of the mc nominal
+// ranges (NN input, reconstruction results). Once all the ranges are done
+// the range shards of an ntuple are added into one shard per ntuple
+// (hist_shards/), the event trees concatenated in range order. A shard is
+// keyed by the ntuple as catalogued (path, size, mtime), its topHFFF
+// filter, the hash of the analysis code (code_key.h) and, for mc only, the
+// key of the systematics and of the streamed trees (data shards are shared
+// by the mc+data and the data-only runs), so later runs process only new
+// or changed ntuples. hists_mc.root and hists_data.root are then the sum
+// of the shards of all the ntuples, and tt_jets_NN_input.root and the
+// reconstruction results their concatenation, always in the order of the
+// list of ranges. MC shards are stored with the normalisation they were
+// filled with and the histograms rescaled to the current one, so a new
+// ntuple of a sample, which changes its sum of weights, doesn't invalidate
+// the other ntuples (the event weights of the streamed trees stay those of
+// their run).
+//
+// The range shards are also the checkpoints of a run: each holds the
+// histograms and events of one done range, i.e. of an ntuple and its
+// entries [first, last). A run killed before the end leaves them in
+// hist_shards/ranges/, and a resumed run only processes the other ranges.
+// The shards of the ntuples are then added in the order of their ranges
+// whatever run did them, so the result is the one of an uninterrupted run.
+class hist_shards
+{
+public:
+  // stream_trees: the event trees of the mc nominal ranges
+  hist_shards(TString dir, TString code_key, TString mc_key, vector<TString> stream_trees = {}, int compression = 101)
+    : dir(dir), code_key(code_key), mc_key(mc_key), stream_trees(stream_trees), compression(compression)
+  {
+    gSystem->mkdir(dir + "ranges/", kTRUE);
+  }
+
+
+  // The ranges of the ntuples without a valid shard, in the same order.
+  // With resume, the ranges done by an interrupted run (valid range
+  // shards) are not processed again either
+  vector<mc_range> missing(const vector<mc_range> &ranges, bool resume = false)
+  {
+    vector<mc_range> to_process;
+    map<TString, bool> valid;
+    int n_reused = 0, n_missing = 0, n_resumed = 0;
+    pending.clear();
+    for (int range_i=0; range_i<ranges.size(); range_i++) {
+      const mc_range &range = ranges[range_i];
+      if (valid.count(range.path) == 0) {
+        double norm_factor = 0;
+        valid[range.path] = read_info(file_shard_path(range), key(range), norm_factor);
+        if (valid[range.path]) n_reused++;
+        else n_missing++; }
+      if (valid[range.path]) continue;
+
+      pending.push_back(range);
+      double norm_factor = 0;
+      if (resume && read_info(range_shard_path(range), key(range), norm_factor)) n_resumed++;
+      else to_process.push_back(range); }
+    cout << "Histogram shards: " << n_reused << " ntuples reused, " << n_missing << " to process";
+    if (resume) cout << ", " << n_resumed << " of their ranges done by an interrupted run";
+    cout << endl;
+    return to_process;
+  }
+
+
+  // True if the range fills the event trees
+  static bool streams(const mc_range &range) { return !range.is_data && range.tree_name == "nominal"; }
+
+
+  // Temporary file of a range about to be processed, for its event trees
+  TFile *open_range(const mc_range &range)
+  {
+    return new TFile (range_shard_path(range) + ".tmp", "RECREATE", "", compression);
+  }
+
+
+  // Save the histograms of a processed range next to its event trees and
+  // their counts, and empty the bank for the next: the checkpoint of the
+  // range, used by a resumed run. The file is renamed only once complete,
+  // so a run killed while writing leaves no range shard
+  template <typename values_t>
+  void close_range(const mc_range &range, TFile *range_file, hist_bank<values_t> &bank, const shard_counts &counts)
+  {
+    range_file->cd();
+    bank.write();
+    write_info(key(range), range.norm_factor, counts);
+    range_file->Close();
+    delete range_file;
+    gSystem->Rename(range_shard_path(range) + ".tmp", range_shard_path(range));
+    bank.reset();
+  }
+
+
+  // Add the range shards of every ntuple missing a shard into its shard,
+  // in the order of its ranges; range shards of a resumed run filled with
+  // another normalisation are rescaled. The banks are only used as buffers.
+  // False if a range shard is missing or invalid: its ntuple gets no shard
+  // and the run can't be completed
+  template <typename values_t>
+  bool combine(hist_bank<values_t> &mc_buffer, hist_bank<values_t> &data_buffer)
+  {
+    bool all_complete = true;
+    vector<vector<int>> file_ranges;
+    map<TString, int> file_index;
+    for (int range_i=0; range_i<pending.size(); range_i++) {
+      if (file_index.count(pending[range_i].path) == 0) {
+        file_index[pending[range_i].path] = file_ranges.size();
+        file_ranges.push_back(vector<int>()); }
+      file_ranges[file_index[pending[range_i].path]].push_back(range_i); }
+
+    for (int file_i=0; file_i<file_ranges.size(); file_i++) {
+      const mc_range &first_range = pending[file_ranges[file_i][0]];
+      hist_bank<values_t> &bank = first_range.is_data ? data_buffer : mc_buffer;
+      bank.reset();
+      shard_counts counts;
+      bool complete = true;
+      for (int i=0; i<file_ranges[file_i].size(); i++) {
+        const mc_range &range = pending[file_ranges[file_i][i]];
+        double stored_norm_factor = 0;
+        shard_counts range_counts;
+        TString range_path = range_shard_path(range);
+        if (read_info(range_path, key(range), stored_norm_factor, &range_counts) == false) { cout << "Histogram shards: no valid range shard " << range_path << endl; complete = false; break; }
+        double scale = 1;
+        if (!range.is_data && stored_norm_factor != 0 && stored_norm_factor != range.norm_factor) scale = range.norm_factor / stored_norm_factor;
+        counts.add(range_counts);
+        TFile *range_shard = new TFile (range_path);
+        bank.add(range_shard, scale);
+        range_shard->Close();
+        delete range_shard; }
+      if (complete == false) { bank.reset(); all_complete = false; continue; }
+
+      TString shard_path = file_shard_path(first_range);
+      TFile *shard = new TFile (shard_path + ".tmp", "RECREATE", "", compression);
+      vector<TString> stream_paths;
+      for (int i=0; i<file_ranges[file_i].size(); i++) {
+        if (streams(pending[file_ranges[file_i][i]])) stream_paths.push_back(range_shard_path(pending[file_ranges[file_i][i]])); }
+      for (int tree_i=0; tree_i<stream_trees.size(); tree_i++) { concatenate(stream_trees[tree_i], stream_paths, shard, true); }
+      shard->cd();
+      bank.write();
+      write_info(key(first_range), first_range.norm_factor, counts);
+      shard->Close();
+      delete shard;
+      gSystem->Rename(shard_path + ".tmp", shard_path);
+      bank.reset();
+      for (int i=0; i<file_ranges[file_i].size(); i++) { gSystem->Unlink(range_shard_path(pending[file_ranges[file_i][i]])); } }
+    return all_complete;
+  }
+
+
+  // Add the shards of all the ntuples of the ranges, in their order, mc
+  // shards scaled to the current normalisation of their sample, and sum
+  // their counts. False if the shard of an ntuple is missing or invalid: the
+  // sums would silently lack it
+  template <typename values_t>
+  bool merge(const vector<mc_range> &ranges, hist_bank<values_t> &mc_bank, hist_bank<values_t> &data_bank, shard_counts &total)
+  {
+    map<TString, bool> added;
+    int n_rescaled = 0;
+    for (int range_i=0; range_i<ranges.size(); range_i++) {
+      const mc_range &range = ranges[range_i];
+      if (added.count(range.path)) continue;
+      added[range.path] = true;
+
+      double stored_norm_factor = 0;
+      shard_counts counts;
+      TString shard_path = file_shard_path(range);
+      if (read_info(shard_path, key(range), stored_norm_factor, &counts) == false) { cout << "Histogram shards: no valid shard " << shard_path << " for " << range.path << endl; return false; }
+      total.add(counts);
+      double scale = 1;
+      if (!range.is_data && stored_norm_factor != 0 && stored_norm_factor != range.norm_factor) {
+        scale = range.norm_factor / stored_norm_factor;
+        n_rescaled++; }
+      TFile *shard = new TFile (shard_path);
+      if (range.is_data) data_bank.add(shard);
+      else mc_bank.add(shard, scale);
+      shard->Close();
+      delete shard; }
+    cout << "Histogram shards: merged " << added.size() << " ntuples, " << n_rescaled << " rescaled to a new normalisation" << endl;
+    return true;
+  }
+
+
+  // Concatenate an event tree of the shards of all the mc ntuples of the
+  // ranges, in their order, into a new file; the number of events
+  Long64_t write_stream(const vector<mc_range> &ranges, TString tree_name, TString output_path)
+  {
+    vector<TString> shard_paths;
+    map<TString, bool> added;
+    for (int range_i=0; range_i<ranges.size(); range_i++) {
+      if (streams(ranges[range_i]) == false || added.count(ranges[range_i].path)) continue;
+      added[ranges[range_i].path] = true;
+      shard_paths.push_back(file_shard_path(ranges[range_i])); }
+    TFile *output = new TFile (output_path, "RECREATE", "", compression);
+    return concatenate(tree_name, shard_paths, output, false);
+  }
+
+
+  // Remove the shards of the ntuples of the ranges and the directories
+  void remove(const vector<mc_range> &ranges)
+  {
+    for (int range_i=0; range_i<ranges.size(); range_i++) {
+      TString shard_path = file_shard_path(ranges[range_i]);
+      if (gSystem->AccessPathName(shard_path) == false) gSystem->Unlink(shard_path); }
+    gSystem->Unlink(dir + "ranges/");
+    gSystem->Unlink(dir);
+  }
+
+
+private:
+  TString key(const mc_range &range) const
+  {
+    return range.path + " " + to_string(range.file_size) + " " + to_string(range.file_mtime) + " " + to_string(range.topHFFF) + " " + code_key + (range.is_data ? TString("") : " " + mc_key);
+  }
+
+
+  TString base_name(const mc_range &range) const
+  {
+    TString name = gSystem->BaseName(range.path);
+    name.ReplaceAll(".root", "");
+    return name + "_" + to_string(range.path.Hash());
+  }
+
+
+  TString file_shard_path(const mc_range &range) const { return dir + base_name(range) + ".root"; }
+
+
+  TString range_shard_path(const mc_range &range) const
+  {
+    return dir + "ranges/" + base_name(range) + "_" + range.tree_name + "_" + to_string(range.first) + "_" + to_string(range.last) + ".root";
+  }
+
+
+  // Copy the baskets of a tree of the given files, in their order, into the
+  // output; the output is closed and deleted unless keep_open
+  static Long64_t concatenate(TString tree_name, const vector<TString> &input_paths, TFile *output, bool keep_open)
+  {
+    TChain chain(tree_name);
+    for (int i=0; i<input_paths.size(); i++) { chain.Add(input_paths[i]); }
+    Long64_t entries = chain.GetEntries();
+    if (input_paths.empty() || chain.LoadTree(0) < 0) {
+      cout << "Histogram shards: no " << tree_name << " tree to write to " << output->GetName() << endl;
+      if (!keep_open) { output->Close(); delete output; }
+      return 0; }
+    output->cd();
+    chain.Merge(output, 0, keep_open ? "fast keep" : "fast");
+    return entries;
+  }
+
+
+  // Key, normalisation and counts of a shard, written to its current directory
+  static void write_info(TString shard_key, double norm_factor, shard_counts counts)
+  {
+    TTree *info = new TTree("shard", "histogram shard");
+    info->Branch("key", &shard_key);
+    info->Branch("norm_factor", &norm_factor, "norm_factor/D");
+    branch_counts(info, counts, true);
+    info->Fill();
+    info->Write();
+  }
+
+
+  // True if the shard exists and has the expected key
+  static bool read_info(TString shard_path, TString expected_key, double &norm_factor, shard_counts *counts = 0)
+  {
+    if (gSystem->AccessPathName(shard_path)) return false;
+    TFile *shard = new TFile (shard_path);
+    TTree *info = (TTree*)shard->Get("shard");
+    bool valid = false;
+    if (info && info->GetEntries() == 1) {
+      TString *shard_key = 0;
+      info->SetBranchAddress("key", &shard_key);
+      info->SetBranchAddress("norm_factor", &norm_factor);
+      if (counts) branch_counts(info, *counts, false);
+      info->GetEntry(0);
+      valid = *shard_key == expected_key;
+      info->ResetBranchAddresses();
+      delete shard_key; }
+    shard->Close();
+    delete shard;
+    return valid;
+  }
+
+
+  // Create or read the branches of the counts in the info tree
+  static void branch_counts(TTree *info, shard_counts &counts, bool create)
+  {
+    vector<pair<TString, Long64_t*>> integers = {{"NN_entries", &counts.NN_entries},
+      {"reco_events", &counts.reco.events}, {"reco_truth_events", &counts.reco.truth_events}, {"reco_correct", &counts.reco.correct},
+      {"prescreen_permutations", &counts.prescreen.permutations}, {"prescreen_kept", &counts.prescreen.kept},
+      {"prescreen_truth_events", &counts.prescreen.truth_events}, {"prescreen_truth_kept", &counts.prescreen.truth_kept}};
+    for (int i=0; i<integers.size(); i++) {
+      if (create) info->Branch(integers[i].first, integers[i].second, integers[i].first + "/L");
+      else info->SetBranchAddress(integers[i].first, integers[i].second); }
+    if (create) info->Branch("reco_seconds", &counts.reco.seconds, "reco_seconds/D");
+    else info->SetBranchAddress("reco_seconds", &counts.reco.seconds);
+  }
+
+  TString dir, code_key, mc_key;
+  vector<TString> stream_trees;
+  int compression;
+  vector<mc_range> pending; // ranges of the ntuples without a valid shard
+};
+
+#endif
@@ -0,0 +1,432 @@
+#ifndef INPUT_CATALOG_H
+#define INPUT_CATALOG_H
+
+#include <TTree.h>
+#include <TFile.h>
+#include <TSystem.h>
+#include <TSystemFile.h>
+#include <TSystemDirectory.h>
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+#include "sample_metadata.h"
+
+using namespace std;
+
+
+
+// ##################################
+// ## Split string into components ##
+// ##################################
+vector<TString> split(TString split_string, char delimiter)
+{
+  stringstream ss;
+  ss << split_string;
+  string component;
+
+  vector<TString> container;
+  while(getline(ss, component, delimiter))
+    {
+      container.push_back(component);
+    }
+
+  return container;
+}
+
+
+
+// #################################################
+// ## Make a list of files in the given directory ##
+// #################################################
+vector<TString> get_list_of_files(TString dirname, vector<TString> container = {})
+{
+  TSystemDirectory dir(dirname, dirname);
+  TList *files = dir.GetListOfFiles();
+  if (files) {
+    TSystemFile *file;
+    TString fname;
+    TIter next(files);
+    while ((file=(TSystemFile*)next())) {
+      fname = file->GetName();
+      if (fname != "." && fname != "..") {
+	if (fname.EndsWith(".root")) { container.push_back(dirname + fname); }
+	else { container.push_back(dirname + fname + "/"); }
+      }
+    }
+  }
+  return container;
+}
+
+
+
+// #####################################
+// ## Last entry + 1 of every cluster ##
+// #####################################
+vector<Long64_t> get_cluster_ends(TTree *tree)
+{
+  vector<Long64_t> ends;
+  Long64_t nEntries = tree->GetEntries();
+  TTree::TClusterIterator clusters = tree->GetClusterIterator(0);
+  while (clusters() < nEntries) { ends.push_back(min(clusters.GetNextEntry(), nEntries)); }
+  return ends;
+}
+
+
+
+// ###########################################
+// ## What the catalog knows about one tree ##
+// ###########################################
+struct catalog_tree
+{
+  TString name;
+  Long64_t entries = -1;        // -1: the file has no such tree
+  Long64_t zip_bytes = 0;
+  vector<Long64_t> cluster_ends;
+};
+
+
+
+// #############################################
+// ## What the catalog knows about one ntuple ##
+// #############################################
+//
+// DID, campaign and AMI tags are parsed once from the directory names
+// (<dataset>_mc16a_.../user.<name>.<DID>.<process>.<...>.<e_s_r_p tags>.../file),
+// trees and sums of weights are read at their first use.
+struct catalog_file
+{
+  TString path, dir;
+  Long64_t size = 0;
+  Long_t mtime = 0;
+  bool is_data = false;
+  int DID = 0;
+  TString campaign;              // mc16a, mc16d, mc16e or empty
+  TString ami_tags;              // e.g. e6337_s3126_r9364_p4031
+  double sum_weights = -1;       // -1: not read yet or no sumWeights tree
+  bool has_sum_weights = false;
+  vector<catalog_tree> trees;
+
+
+  // i-th AMI tag, "" if there are fewer
+  TString ami_tag(int i) const
+  {
+    vector<TString> tags = split(ami_tags, '_');
+    return i < tags.size() ? tags[i] : TString("");
+  }
+
+
+  const catalog_tree *tree(TString name) const
+  {
+    for (int tree_i=0; tree_i<trees.size(); tree_i++) { if (trees[tree_i].name == name) return &trees[tree_i]; }
+    return 0;
+  }
+};
+
+
+
+// ################################################################
+// ## Local index of the ntuples, refreshed instead of re-listed ##
+// ################################################################
+//
+// Listing EOS with TSystemDirectory and opening every ntuple to count its
+// entries is slow, so the catalog keeps, in one local ROOT file
+// (input_catalog.root), every directory with its mtime and every ntuple
+// with its size, mtime, parsed DID/campaign/tags, sum of weights and the
+// entries and cluster boundaries of the trees read so far. A refresh
+// only stats the known directories and lists again the ones whose mtime
+// changed; an ntuple is opened again only when its size or mtime changed.
+// Ntuples rewritten in place, without touching their directory, are not
+// noticed: remove the index to rebuild it.
+class input_catalog
+{
+public:
+  input_catalog(TString index_path = "input_catalog.root") : index_path(index_path) { read(); }
+
+
+  // All the ntuples under root_dir, in path order, listing again only the
+  // directories that changed since the index was written
+  vector<catalog_file*> files_under(TString root_dir)
+  {
+    refresh(root_dir);
+    vector<catalog_file*> found;
+    collect(root_dir, found);
+    sort(found.begin(), found.end(), [](const catalog_file *a, const catalog_file *b) { return a->path < b->path; });
+    cout << "Catalog " << index_path << ": " << found.size() << " ntuples under " << root_dir << ", "
+         << n_listed << " directories listed, " << n_stat << " stat" << endl;
+    return found;
+  }
+
+
+  // The given trees and, for mc, the sum of weights of an ntuple, opened
+  // only if some of them were never read
+  void describe(catalog_file &file, const vector<TString> &tree_names)
+  {
+    bool complete = file.is_data || file.has_sum_weights;
+    for (int tree_i=0; tree_i<tree_names.size(); tree_i++) { if (!file.tree(tree_names[tree_i])) complete = false; }
+    if (complete) return;
+
+    TFile *ntuple = new TFile (file.path);
+    if (!file.is_data && !file.has_sum_weights) {
+      file.sum_weights = read_sum_weights(ntuple);
+      file.has_sum_weights = true; }
+    for (int tree_i=0; tree_i<tree_names.size(); tree_i++) {
+      if (file.tree(tree_names[tree_i])) continue;
+      catalog_tree info;
+      info.name = tree_names[tree_i];
+      TTree *tree = (TTree*)ntuple->Get(tree_names[tree_i]);
+      if (tree) {
+        info.entries = tree->GetEntries();
+        info.zip_bytes = tree->GetZipBytes();
+        info.cluster_ends = get_cluster_ends(tree); }
+      file.trees.push_back(info); }
+    ntuple->Close();
+    delete ntuple;
+    n_opened++;
+    changed = true;
+  }
+
+
+  // Save the index if anything changed
+  void write()
+  {
+    if (!changed) return;
+    TFile *index_file = new TFile (index_path, "RECREATE");
+
+    TString path, parent, dir, campaign, ami_tags, name;
+    Long_t mtime = 0;
+    TTree *dirs_tree = new TTree("directories", "listed directories");
+    dirs_tree->Branch("path", &path);
+    dirs_tree->Branch("parent", &parent);
+    dirs_tree->Branch("mtime", &mtime, "mtime/L");
+    for (map<TString, catalog_dir>::iterator d=dirs.begin(); d!=dirs.end(); d++) {
+      path = d->first;
+      parent = d->second.parent;
+      mtime = d->second.mtime;
+      dirs_tree->Fill(); }
+
+    Long64_t size = 0;
+    bool is_data = false, has_sum_weights = false;
+    int DID = 0;
+    double sum_weights = 0;
+    TTree *files_tree = new TTree("files", "ntuples");
+    files_tree->Branch("path", &path);
+    files_tree->Branch("dir", &dir);
+    files_tree->Branch("size", &size, "size/L");
+    files_tree->Branch("mtime", &mtime, "mtime/L");
+    files_tree->Branch("is_data", &is_data, "is_data/O");
+    files_tree->Branch("DID", &DID, "DID/I");
+    files_tree->Branch("campaign", &campaign);
+    files_tree->Branch("ami_tags", &ami_tags);
+    files_tree->Branch("sum_weights", &sum_weights, "sum_weights/D");
+    files_tree->Branch("has_sum_weights", &has_sum_weights, "has_sum_weights/O");
+
+    Long64_t entries = 0, zip_bytes = 0;
+    vector<Long64_t> cluster_ends;
+    TTree *trees_tree = new TTree("trees", "trees of the ntuples");
+    trees_tree->Branch("path", &path);
+    trees_tree->Branch("name", &name);
+    trees_tree->Branch("entries", &entries, "entries/L");
+    trees_tree->Branch("zip_bytes", &zip_bytes, "zip_bytes/L");
+    trees_tree->Branch("cluster_ends", &cluster_ends);
+
+    for (map<TString, catalog_file>::iterator f=files.begin(); f!=files.end(); f++) {
+      const catalog_file &file = f->second;
+      path = file.path; dir = file.dir; size = file.size; mtime = file.mtime; is_data = file.is_data; DID = file.DID;
+      campaign = file.campaign; ami_tags = file.ami_tags; sum_weights = file.sum_weights; has_sum_weights = file.has_sum_weights;
+      files_tree->Fill();
+      for (int tree_i=0; tree_i<file.trees.size(); tree_i++) {
+        name = file.trees[tree_i].name;
+        entries = file.trees[tree_i].entries;
+        zip_bytes = file.trees[tree_i].zip_bytes;
+        cluster_ends = file.trees[tree_i].cluster_ends;
+        trees_tree->Fill(); } }
+
+    index_file->Write();
+    index_file->Close();
+    delete index_file;
+    changed = false;
+    cout << "Catalog " << index_path << " written, " << n_opened << " ntuples opened" << endl;
+  }
+
+
+private:
+  struct catalog_dir
+  {
+    TString parent;
+    Long_t mtime = 0;
+    vector<TString> subdirs, files;
+  };
+
+
+  void read()
+  {
+    if (gSystem->AccessPathName(index_path)) return;
+    TFile *index_file = new TFile (index_path);
+    TTree *dirs_tree = (TTree*)index_file->Get("directories");
+    TTree *files_tree = (TTree*)index_file->Get("files");
+    TTree *trees_tree = (TTree*)index_file->Get("trees");
+    if (!dirs_tree || !files_tree || !trees_tree) { index_file->Close(); delete index_file; return; }
+
+    TString *path = 0, *parent = 0, *dir = 0, *campaign = 0, *ami_tags = 0, *name = 0;
+    Long_t mtime = 0;
+    dirs_tree->SetBranchAddress("path", &path);
+    dirs_tree->SetBranchAddress("parent", &parent);
+    dirs_tree->SetBranchAddress("mtime", &mtime);
+    for (Long64_t entry=0; entry<dirs_tree->GetEntries(); entry++) {
+      dirs_tree->GetEntry(entry);
+      dirs[*path].parent = *parent;
+      dirs[*path].mtime = mtime; }
+    for (map<TString, catalog_dir>::iterator d=dirs.begin(); d!=dirs.end(); d++) {
+      if (dirs.count(d->second.parent)) dirs[d->second.parent].subdirs.push_back(d->first); }
+
+    catalog_file file;
+    files_tree->SetBranchAddress("path", &path);
+    files_tree->SetBranchAddress("dir", &dir);
+    files_tree->SetBranchAddress("size", &file.size);
+    files_tree->SetBranchAddress("mtime", &file.mtime);
+    files_tree->SetBranchAddress("is_data", &file.is_data);
+    files_tree->SetBranchAddress("DID", &file.DID);
+    files_tree->SetBranchAddress("campaign", &campaign);
+    files_tree->SetBranchAddress("ami_tags", &ami_tags);
+    files_tree->SetBranchAddress("sum_weights", &file.sum_weights);
+    files_tree->SetBranchAddress("has_sum_weights", &file.has_sum_weights);
+    for (Long64_t entry=0; entry<files_tree->GetEntries(); entry++) {
+      files_tree->GetEntry(entry);
+      file.path = *path; file.dir = *dir; file.campaign = *campaign; file.ami_tags = *ami_tags;
+      files[file.path] = file;
+      if (dirs.count(file.dir)) dirs[file.dir].files.push_back(file.path); }
+
+    catalog_tree info;
+    vector<Long64_t> *cluster_ends = 0;
+    trees_tree->SetBranchAddress("path", &path);
+    trees_tree->SetBranchAddress("name", &name);
+    trees_tree->SetBranchAddress("entries", &info.entries);
+    trees_tree->SetBranchAddress("zip_bytes", &info.zip_bytes);
+    trees_tree->SetBranchAddress("cluster_ends", &cluster_ends);
+    for (Long64_t entry=0; entry<trees_tree->GetEntries(); entry++) {
+      trees_tree->GetEntry(entry);
+      if (!files.count(*path)) continue;
+      info.name = *name;
+      info.cluster_ends = *cluster_ends;
+      files[*path].trees.push_back(info); }
+
+    index_file->Close();
+    delete index_file;
+  }
+
+
+  // Stat a known directory and list it again only if its mtime changed,
+  // then the same for its subdirectories
+  void refresh(TString dir_path, TString parent = "")
+  {
+    FileStat_t stat;
+    n_stat++;
+    if (gSystem->GetPathInfo(dir_path, stat)) { cout << "Can't access " << dir_path << endl; forget(dir_path); return; }
+
+    map<TString, catalog_dir>::iterator known = dirs.find(dir_path);
+    if (known == dirs.end() || known->second.mtime != stat.fMtime) {
+      list(dir_path, parent, stat.fMtime);
+      known = dirs.find(dir_path); }
+    if (parent != "" && known->second.parent != parent) { known->second.parent = parent; changed = true; }
+
+    vector<TString> subdirs = known->second.subdirs;
+    for (int sub_i=0; sub_i<subdirs.size(); sub_i++) { refresh(subdirs[sub_i], dir_path); }
+  }
+
+
+  // List a new or changed directory: new and changed ntuples are parsed
+  // again, removed ones and removed subdirectories are forgotten
+  void list(TString dir_path, TString parent, Long_t mtime)
+  {
+    n_listed++;
+    changed = true;
+    catalog_dir listed;
+    listed.parent = parent;
+    listed.mtime = mtime;
+
+    vector<TString> contents = get_list_of_files(dir_path);
+    for (int content_i=0; content_i<contents.size(); content_i++) {
+      FileStat_t stat;
+      if (gSystem->GetPathInfo(contents[content_i], stat)) continue;
+      if (R_ISDIR(stat.fMode)) { listed.subdirs.push_back(contents[content_i]); continue; }
+      if (!contents[content_i].EndsWith(".root")) continue;
+      listed.files.push_back(contents[content_i]);
+      map<TString, catalog_file>::iterator known = files.find(contents[content_i]);
+      if (known != files.end() && known->second.size == stat.fSize && known->second.mtime == stat.fMtime) continue;
+      files[contents[content_i]] = parse(contents[content_i], dir_path, stat); }
+
+    // What was there before and is gone now
+    map<TString, catalog_dir>::iterator before = dirs.find(dir_path);
+    if (before != dirs.end()) {
+      for (int file_i=0; file_i<before->second.files.size(); file_i++) {
+        if (find(listed.files.begin(), listed.files.end(), before->second.files[file_i]) == listed.files.end()) files.erase(before->second.files[file_i]); }
+      for (int sub_i=0; sub_i<before->second.subdirs.size(); sub_i++) {
+        if (find(listed.subdirs.begin(), listed.subdirs.end(), before->second.subdirs[sub_i]) == listed.subdirs.end()) forget(before->second.subdirs[sub_i]); } }
+    dirs[dir_path] = listed;
+  }
+
+
+  // Drop a directory, its ntuples and its subdirectories
+  void forget(TString dir_path)
+  {
+    map<TString, catalog_dir>::iterator known = dirs.find(dir_path);
+    if (known == dirs.end()) return;
+    catalog_dir gone = known->second;
+    dirs.erase(known);
+    for (int file_i=0; file_i<gone.files.size(); file_i++) { files.erase(gone.files[file_i]); }
+    for (int sub_i=0; sub_i<gone.subdirs.size(); sub_i++) { forget(gone.subdirs[sub_i]); }
+    changed = true;
+  }
+
+
+  void collect(TString dir_path, vector<catalog_file*> &found)
+  {
+    map<TString, catalog_dir>::iterator known = dirs.find(dir_path);
+    if (known == dirs.end()) return;
+    for (int file_i=0; file_i<known->second.files.size(); file_i++) { found.push_back(&files[known->second.files[file_i]]); }
+    for (int sub_i=0; sub_i<known->second.subdirs.size(); sub_i++) { collect(known->second.subdirs[sub_i], found); }
+  }
+
+
+  // DID, campaign and tags from the job and dataset directory names, the
+  // way the mc and data macros always parsed them
+  static catalog_file parse(TString file_path, TString dir_path, const FileStat_t &stat)
+  {
+    catalog_file file;
+    file.path = file_path;
+    file.dir = dir_path;
+    file.size = stat.fSize;
+    file.mtime = stat.fMtime;
+
+    vector<TString> path_components = split(file_path, '/');
+    int n = path_components.size();
+    TString job_name = n >= 2 ? path_components[n-2] : "";
+    TString dataset_name = n >= 3 ? path_components[n-3] : "";
+
+    // Data: <period dir with periodAllYear>/file or <dataset with _data_>/<job>/file
+    vector<TString> job_name_components = split(job_name, '.');
+    for (int i=0; i<job_name_components.size(); i++) { if (job_name_components[i] == "periodAllYear") file.is_data = true; }
+    vector<TString> dataset_name_components = split(dataset_name, '_');
+    for (int i=0; i<dataset_name_components.size(); i++) {
+      if (dataset_name_components[i] == "data") file.is_data = true;
+      if (dataset_name_components[i] == "mc16a" || dataset_name_components[i] == "mc16d" || dataset_name_components[i] == "mc16e") file.campaign = dataset_name_components[i]; }
+
+    if (!file.is_data && job_name_components.size() > 5) {
+      file.DID = job_name_components[2].Atoi();
+      file.ami_tags = job_name_components[5]; }
+    return file;
+  }
+
+
+  TString index_path;
+  map<TString, catalog_dir> dirs;
+  map<TString, catalog_file> files;
+  bool changed = false;
+  int n_listed = 0, n_stat = 0, n_opened = 0;
+};
+
+#endif
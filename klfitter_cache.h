@@ -0,0 +1,141 @@
+#ifndef KLFITTER_CACHE_H
+#define KLFITTER_CACHE_H
+
+#include <TTree.h>
+#include <TFile.h>
+#include <TSystem.h>
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <utility>
+
+#include "reco_results.h"
+
+using namespace std;
+
+
+
+// ################################################################
+// ## KLFitter results of a range of entries, saved between runs ##
+// ################################################################
+//
+// Works like selection_masks.h: the results of the fits of a range are
+// written to a small file in klfitter_cache/, keyed by (runNumber,
+// eventNumber) and stored with the hash of the fit inputs. Later runs look
+// the events up and only refit those that are missing or whose inputs
+// changed. The fit configuration (transfer functions, jets, top mass) is
+// part of the file name, so changing it starts a new cache.
+class klf_cache
+{
+public:
+  klf_cache(TString ntuple_path, Long64_t first, Long64_t last, TString tree_name, TString config_key, TString dir = "klfitter_cache/")
+  {
+    TString base_name = gSystem->BaseName(ntuple_path);
+    base_name.ReplaceAll(".root", "");
+    if (tree_name != "nominal") base_name += "_" + tree_name;
+    cache_path = dir + base_name + "_" + to_string(ntuple_path.Hash()) + "_" + to_string(first) + "_" + to_string(last) + "_" + config_key + ".root";
+    cache_dir = dir;
+  }
+
+
+  // Read the results of earlier runs, false if there are none for the range
+  bool read()
+  {
+    if (gSystem->AccessPathName(cache_path)) return false;
+    TFile *cache_file = new TFile (cache_path);
+    TTree *tree_klf = (TTree*)cache_file->Get("klfitter");
+    if (tree_klf) {
+      UInt_t runNumber = 0;
+      ULong64_t eventNumber = 0, input_hash = 0;
+      klf_result result;
+      set_branches(tree_klf, runNumber, eventNumber, input_hash, result);
+      for (Long64_t entry=0; entry<tree_klf->GetEntries(); entry++) {
+        tree_klf->GetEntry(entry);
+        results[make_pair(runNumber, eventNumber)] = make_pair(input_hash, result); } }
+    cache_file->Close();
+    delete cache_file;
+    return tree_klf != 0;
+  }
+
+
+  // Result of an earlier fit of the event with the same inputs
+  bool lookup(UInt_t runNumber, ULong64_t eventNumber, ULong64_t input_hash, klf_result &result)
+  {
+    map<pair<UInt_t, ULong64_t>, pair<ULong64_t, klf_result>>::const_iterator cached = results.find(make_pair(runNumber, eventNumber));
+    if (cached == results.end() || cached->second.first != input_hash) { n_missed++; return false; }
+    result = cached->second.second;
+    n_hits++;
+    return true;
+  }
+
+
+  // Record a new fit
+  void store(UInt_t runNumber, ULong64_t eventNumber, ULong64_t input_hash, const klf_result &result)
+  {
+    results[make_pair(runNumber, eventNumber)] = make_pair(input_hash, result);
+  }
+
+
+  // Save all the results if any fit was added this run
+  void write()
+  {
+    if (n_missed == 0) return;
+    gSystem->mkdir(cache_dir, kTRUE);
+    TFile *cache_file = new TFile (cache_path, "RECREATE");
+    TTree *tree_klf = new TTree("klfitter", "klfitter");
+    UInt_t runNumber = 0;
+    ULong64_t eventNumber = 0, input_hash = 0;
+    klf_result result;
+    book_branches(tree_klf, runNumber, eventNumber, input_hash, result);
+    for (map<pair<UInt_t, ULong64_t>, pair<ULong64_t, klf_result>>::const_iterator cached = results.begin(); cached != results.end(); ++cached) {
+      runNumber = cached->first.first;
+      eventNumber = cached->first.second;
+      input_hash = cached->second.first;
+      result = cached->second.second;
+      tree_klf->Fill(); }
+    tree_klf->Write();
+    cache_file->Close();
+    delete cache_file;
+  }
+
+
+  Long64_t hits() const { return n_hits; }
+  Long64_t missed() const { return n_missed; }
+
+
+private:
+  static void book_branches(TTree *tree, UInt_t &runNumber, ULong64_t &eventNumber, ULong64_t &input_hash, klf_result &result)
+  {
+    tree->Branch("runNumber", &runNumber, "runNumber/i");
+    tree->Branch("eventNumber", &eventNumber, "eventNumber/l");
+    tree->Branch("input_hash", &input_hash, "input_hash/l");
+    tree->Branch("n_permutations", &result.n_permutations, "n_permutations/I");
+    tree->Branch("converged", &result.converged, "converged/O");
+    tree->Branch("log_likelihood", &result.log_likelihood, "log_likelihood/D");
+    tree->Branch("log_event_probability", &result.log_event_probability, "log_event_probability/D");
+    tree->Branch("b_index", result.b_index, "b_index[2]/I");
+    tree->Branch("top_mass", &result.top_mass, "top_mass/D");
+    tree->Branch("mlb", result.mlb, "mlb[2]/D");
+  }
+
+  static void set_branches(TTree *tree, UInt_t &runNumber, ULong64_t &eventNumber, ULong64_t &input_hash, klf_result &result)
+  {
+    tree->SetBranchAddress("runNumber", &runNumber);
+    tree->SetBranchAddress("eventNumber", &eventNumber);
+    tree->SetBranchAddress("input_hash", &input_hash);
+    tree->SetBranchAddress("n_permutations", &result.n_permutations);
+    tree->SetBranchAddress("converged", &result.converged);
+    tree->SetBranchAddress("log_likelihood", &result.log_likelihood);
+    tree->SetBranchAddress("log_event_probability", &result.log_event_probability);
+    tree->SetBranchAddress("b_index", result.b_index);
+    tree->SetBranchAddress("top_mass", &result.top_mass);
+    tree->SetBranchAddress("mlb", result.mlb);
+  }
+
+  TString cache_path, cache_dir;
+  map<pair<UInt_t, ULong64_t>, pair<ULong64_t, klf_result>> results;
+  Long64_t n_hits = 0, n_missed = 0;
+};
+
+#endif
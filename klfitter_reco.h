@@ -0,0 +1,238 @@
+#ifndef KLFITTER_RECO_H
+#define KLFITTER_RECO_H
+
+#include <TLorentzVector.h>
+
+#include <iostream>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <algorithm>
+#include <cmath>
+
+#ifndef TTHF_NO_KLFITTER
+#include "KLFitter/DetectorAtlas_8TeV.h"
+#include "KLFitter/Fitter.h"
+#include "KLFitter/LikelihoodTopDilepton.h"
+#include "KLFitter/Permutations.h"
+#endif
+
+#include "mc_inputs.h"
+#include "event_kinematics.h"
+#include "reco_results.h"
+
+using namespace std;
+
+
+
+#ifndef TTHF_NO_KLFITTER
+// #################################################################
+// ## KLFitter dilepton reconstruction owned by one worker thread ##
+// #################################################################
+//
+// Fitter, detector and likelihood keep per-event state, so every worker
+// builds its own instance. The minimisation behind Fitter::Fit() (BAT and
+// TMinuit) keeps process-global state, its static FCN and gMinuit, so the
+// fits themselves are serialised by one mutex shared by all the instances:
+// workers prepare, screen and read back permutations concurrently, but only
+// one fit runs at a time. The electron and the muon are the two leptons, the leading n_jets jets
+// are permuted as the two b candidates, after the pre-screening if enabled.
+class klf_reco
+{
+public:
+  klf_reco(TString transfer_functions = "/cvmfs/atlas.cern.ch/repo/sw/database/GroupData/dev/AnalysisTop/KLFitterTFs/mc15c/akt4_EMtopo_PP6",
+           bool top_mass_fixed = true, int n_jets = 3)
+    : detector(transfer_functions.Data()), transfer_functions(transfer_functions), top_mass_fixed(top_mass_fixed), n_jets(n_jets)
+  {
+    fitter.SetDetector(&detector);
+    likelihood.PhysicsConstants()->SetMassTop(top_mass);
+    likelihood.SetBTagging(KLFitter::LikelihoodBase::BtaggingMethod::kNotag);
+    likelihood.SetFlagTopMassFixed(top_mass_fixed);
+    likelihood.SetLeptonType(KLFitter::LikelihoodTopDilepton::kElectron, KLFitter::LikelihoodTopDilepton::kMuon);
+    fitter.SetLikelihood(&likelihood);
+  }
+
+
+  // Fit all the permutations of an event and keep the most likely one
+  klf_result fit(const mc_event &ev, const event_kinematics &kin)
+  {
+    klf_result result;
+    KLFitter::Particles particles{};
+
+    // Leptons
+    TLorentzVector el_lvec, mu_lvec;
+    el_lvec.SetPtEtaPhiE(kin.lep_pt[0], kin.lep_eta[0], kin.lep_phi[0], kin.lep_e[0]);
+    mu_lvec.SetPtEtaPhiE(kin.lep_pt[1], kin.lep_eta[1], kin.lep_phi[1], kin.lep_e[1]);
+    particles.AddParticle(el_lvec, (*ev.el_cl_eta)[0], (*ev.el_charge)[0], KLFitter::Particles::kElectron);
+    particles.AddParticle(mu_lvec, mu_lvec.Eta(), (*ev.mu_charge)[0], KLFitter::Particles::kMuon);
+
+    // Leading jets
+    for (int jet_i=0; jet_i<min(n_jets, kin.n_jets); jet_i++) {
+      TLorentzVector jet_lvec;
+      jet_lvec.SetPtEtaPhiE(kin.jet_pt[jet_i], kin.jet_eta[jet_i], kin.jet_phi[jet_i], kin.jet_e[jet_i]);
+      particles.AddParticle(jet_lvec, jet_lvec.Eta(), KLFitter::Particles::kParton, "", jet_i); }
+    fitter.SetParticles(&particles);
+
+    // MET
+    fitter.SetET_miss_XY_SumET(ev.met*0.001*cos(ev.met_phi), ev.met*0.001*sin(ev.met_phi), ev.met*0.001);
+
+
+    // Screen the permutations before any fit
+    result.n_permutations = fitter.Permutations()->NPermutations();
+    screen(ev, kin, result.n_permutations);
+    result.n_fitted = to_fit.size();
+
+
+    // Loop over the permutations left
+    for (int fit_i=0; fit_i<to_fit.size(); fit_i++) {
+      vector<double> parameters;
+      double llh = 0;
+      {
+        lock_guard<mutex> lock(fit_mutex());
+        fitter.Fit(to_fit[fit_i]);
+        parameters = fitter.Likelihood()->GetBestFitParameters();
+        llh = fitter.Likelihood()->LogLikelihood(parameters);
+      }
+      if (llh <= result.log_likelihood) continue;
+
+      KLFitter::Particles *permuted = *fitter.Likelihood()->PParticlesPermuted();
+      result.log_likelihood = llh;
+      result.log_event_probability = fitter.Likelihood()->LogEventProbability();
+      result.converged = fitter.ConvergenceStatus() == 0;
+      result.b_index[0] = permuted->JetIndex(0);
+      result.b_index[1] = permuted->JetIndex(1);
+      result.top_mass = top_mass_fixed ? top_mass : parameters[KLFitter::LikelihoodTopDilepton::parTopM]; }
+
+    for (int l=0; l<event_kinematics::n_leps; l++) {
+      if (result.b_index[l] >= 0) result.mlb[l] = kin.mass_jet_lep(result.b_index[l], l); }
+
+    return result;
+  }
+
+
+  // Hash of everything the fit of an event depends on, as read from the ntuple
+  ULong64_t input_hash(const mc_event &ev) const
+  {
+    ULong64_t hash = 14695981039346656037ULL;
+    hash_values(hash, *ev.el_pt, 1); hash_values(hash, *ev.el_eta, 1); hash_values(hash, *ev.el_cl_eta, 1);
+    hash_values(hash, *ev.el_phi, 1); hash_values(hash, *ev.el_e, 1); hash_values(hash, *ev.el_charge, 1);
+    hash_values(hash, *ev.mu_pt, 1); hash_values(hash, *ev.mu_eta, 1);
+    hash_values(hash, *ev.mu_phi, 1); hash_values(hash, *ev.mu_e, 1); hash_values(hash, *ev.mu_charge, 1);
+    hash_values(hash, *ev.jet_pt, n_jets); hash_values(hash, *ev.jet_eta, n_jets);
+    hash_values(hash, *ev.jet_phi, n_jets); hash_values(hash, *ev.jet_e, n_jets);
+    hash_bytes(hash, &ev.met, sizeof(ev.met));
+    hash_bytes(hash, &ev.met_phi, sizeof(ev.met_phi));
+    return hash;
+  }
+
+
+  // Short key of the fit configuration, changes with the transfer functions,
+  // the number of jets, the top mass treatment or the pre-screening. "serial"
+  // marks the fits done behind fit_mutex(), caches of concurrent fits are
+  // not reused
+  TString config_key() const
+  {
+    TString config = "serial_" + transfer_functions + "_" + to_string(n_jets) + (top_mass_fixed ? "_fixed" : "_free") + prescreen.key();
+    return to_string(config.Hash());
+  }
+
+
+  klf_prescreen prescreen;
+  klf_prescreen_stats stats;
+
+
+private:
+  // Guards the global state of the minimiser, shared by all the workers
+  static mutex &fit_mutex()
+  {
+    static mutex shared;
+    return shared;
+  }
+
+
+  // Fill to_fit with the permutations passing the pre-screening, best ranked first
+  void screen(const mc_event &ev, const event_kinematics &kin, int n_permutations)
+  {
+    int n_fit_jets = min(n_jets, kin.n_jets);
+    DL1r_rank.assign(n_fit_jets, 0);
+    for (int i=0; i<n_fit_jets; i++) {
+      for (int j=0; j<n_fit_jets; j++) { if ((*ev.jet_DL1r)[j] > (*ev.jet_DL1r)[i]) DL1r_rank[i]++; } }
+
+    ranked.clear();
+    bool has_truth = false, truth_kept = false;
+    double best_score = 1e10;
+    int best_perm = -1;
+    for (int perm_i=0; perm_i<n_permutations; perm_i++) {
+      fitter.Permutations()->SetPermutation(perm_i);
+      KLFitter::Particles *permuted = *fitter.Permutations()->ParticlesPermuted();
+      int b_el = permuted->JetIndex(0), b_mu = permuted->JetIndex(1);
+      if (b_el < 0 || b_mu < 0) continue;
+      double score = klf_prescreen::score(b_el, b_mu, kin);
+      bool truth = is_b_from_top(ev, b_el) && is_b_from_top(ev, b_mu);
+      has_truth = has_truth || truth;
+      if (score < best_score) { best_score = score; best_perm = perm_i; }
+      if (prescreen.enabled==false || prescreen.passes(b_el, b_mu, kin, DL1r_rank)) ranked.push_back(make_pair(score, perm_i)); }
+    if (ranked.empty() && best_perm >= 0) ranked.push_back(make_pair(best_score, best_perm));
+
+    // Keep the best ranked fraction
+    sort(ranked.begin(), ranked.end());
+    int n_keep = ranked.size();
+    if (prescreen.enabled) n_keep = min(n_keep, max(1, int(ceil(prescreen.keep_fraction * n_permutations))));
+    to_fit.clear();
+    for (int i=0; i<n_keep; i++) { to_fit.push_back(ranked[i].second); }
+
+    // Efficiency of keeping the truth-correct assignment
+    for (int i=0; i<n_keep && has_truth; i++) {
+      fitter.Permutations()->SetPermutation(to_fit[i]);
+      KLFitter::Particles *permuted = *fitter.Permutations()->ParticlesPermuted();
+      if (is_b_from_top(ev, permuted->JetIndex(0)) && is_b_from_top(ev, permuted->JetIndex(1))) truth_kept = true; }
+    stats.permutations += n_permutations;
+    stats.kept += n_keep;
+    if (has_truth) stats.truth_events++;
+    if (truth_kept) stats.truth_kept++;
+  }
+
+  // FNV-1a over the first n values of a branch
+  static void hash_values(ULong64_t &hash, const vector<Float_t> &values, int n)
+  {
+    int n_values = min(n, int(values.size()));
+    hash_bytes(hash, &n_values, sizeof(n_values));
+    if (n_values > 0) hash_bytes(hash, &values[0], n_values * sizeof(Float_t));
+  }
+
+  static void hash_bytes(ULong64_t &hash, const void *data, size_t n_bytes)
+  {
+    const unsigned char *bytes = (const unsigned char*)data;
+    for (size_t i=0; i<n_bytes; i++) { hash = (hash ^ bytes[i]) * 1099511628211ULL; }
+  }
+
+  KLFitter::DetectorAtlas_8TeV detector;
+  KLFitter::LikelihoodTopDilepton likelihood{};
+  KLFitter::Fitter fitter{};
+  TString transfer_functions;
+  bool top_mass_fixed;
+  int n_jets;
+  const double top_mass = 172.5;
+  vector<int> DL1r_rank, to_fit;
+  vector<pair<double, int>> ranked;
+};
+
+#else
+
+// Built without KLFitter (TTHF_NO_KLFITTER, e.g. prepare_hists_data): same
+// interface so the event processing compiles, the "klfitter" stage is
+// refused by prepare_hists_mc before any worker builds one
+class klf_reco
+{
+public:
+  klf_result fit(const mc_event &ev, const event_kinematics &kin) { return klf_result(); }
+  ULong64_t input_hash(const mc_event &ev) const { return 0; }
+  TString config_key() const { return "no_klfitter"; }
+
+  klf_prescreen prescreen;
+  klf_prescreen_stats stats;
+};
+
+#endif
+
+#endif
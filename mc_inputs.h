@@ -0,0 +1,448 @@
+#ifndef MC_INPUTS_H
+#define MC_INPUTS_H
+
+#include <TTree.h>
+#include <TFile.h>
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "branch_manifest.h"
+#include "input_catalog.h"
+#include "sample_metadata.h"
+#include "selection_masks.h"
+#include "systematics.h"
+
+using namespace std;
+
+
+
+// ###########################################################
+// ## Split a tree into entry ranges made of whole clusters ##
+// ###########################################################
+vector<pair<Long64_t, Long64_t>> get_cluster_ranges(const vector<Long64_t> &cluster_ends, Long64_t min_entries)
+{
+  // Every range holds at least min_entries (except the last one)
+  // and never cuts a cluster (basket group) in two
+  vector<pair<Long64_t, Long64_t>> ranges;
+  Long64_t range_start = 0;
+  for (int cluster_i=0; cluster_i<cluster_ends.size(); cluster_i++) {
+    Long64_t cluster_end = cluster_ends[cluster_i];
+    if (cluster_end - range_start >= min_entries || cluster_i == cluster_ends.size()-1) {
+      ranges.push_back(make_pair(range_start, cluster_end));
+      range_start = cluster_end; } }
+
+  return ranges;
+}
+
+
+
+// ###########################################
+// ## A range of entries of a single ntuple ##
+// ###########################################
+struct mc_range
+{
+  TString path;     // path to the ntuple
+  Long64_t file_size; // size and mtime of the ntuple, as catalogued
+  Long_t file_mtime;
+  TString tree_name; // "nominal" or a tree of systematic variations
+  int sample_DID;   // DID of the job the ntuple belongs to
+  TString campaign; // mc16a, mc16d or mc16e
+  double norm_factor; // lumi * xsec * genFiltEff * kFactor / sumWeights of the sample
+  int topHFFF;      // topHeavyFlavorFilterFlag kept for the sample, -1 keeps all
+  bool only_410472; // testing option: keep only tt+all
+  bool from_skim;   // the ntuple is a skim written by skim_mc.c
+  bool is_data;     // a data ntuple: no truth branches and no weights
+  Long64_t first;   // first entry of the range
+  Long64_t last;    // one past the last entry of the range
+  Long64_t size;    // compressed bytes of the range, used to order the work
+  int index;        // position of the range in the serial order
+};
+
+
+
+// #####################################################
+// ## Cut one tree of a catalogued ntuple into ranges ##
+// #####################################################
+void add_tree_ranges(vector<mc_range> &ranges, const catalog_file &file, TString tree_name, Long64_t entries_per_range, const mc_range &prototype)
+{
+  const catalog_tree *tree = file.tree(tree_name);
+  if (!tree || tree->entries < 0) { cout << file.path << ": no tree " << tree_name << endl; return; }
+
+  vector<pair<Long64_t, Long64_t>> cluster_ranges = get_cluster_ranges(tree->cluster_ends, entries_per_range);
+  for (int range_i=0; range_i<cluster_ranges.size(); range_i++) {
+    Long64_t range_entries = cluster_ranges[range_i].second - cluster_ranges[range_i].first;
+    mc_range range = prototype;
+    range.path = file.path;
+    range.file_size = file.size;
+    range.file_mtime = file.mtime;
+    range.tree_name = tree_name;
+    range.first = cluster_ranges[range_i].first;
+    range.last = cluster_ranges[range_i].second;
+    range.index = ranges.size();
+    range.size = tree->zip_bytes * range_entries / max(tree->entries, Long64_t(1));
+    ranges.push_back(range); }
+}
+
+
+
+// #######################################################################
+// ## Flatten the directory/job/ntuple hierarchy into ranges of entries ##
+// #######################################################################
+//
+// The ntuples, their DIDs, campaigns, tags, sums of weights and cluster
+// boundaries come from the input catalog (input_catalog.h), which only
+// lists the directories changed since the previous run and opens only
+// new or changed ntuples.
+vector<mc_range> get_list_of_ranges(TString path_to_ntuples, Long64_t entries_per_range, TString metadata_table = "sample_metadata.txt", vector<TString> tree_names = {"nominal"}, TString catalog_path = "input_catalog.root")
+{
+  // Samples to process and their cross-sections
+  sample_metadata metadata;
+  metadata.read_table(metadata_table);
+
+
+  // Ntuples under the given directory: mc16a, mc16d, mc16e / jobs / ntuples
+  input_catalog catalog(catalog_path);
+  vector<catalog_file*> files = catalog.files_under(path_to_ntuples);
+
+
+  // Ranges of entries to be processed by the workers
+  vector<mc_range> ranges;
+  TString previous_job = "";
+  for (int file_i=0; file_i<files.size(); file_i++)
+    {
+      catalog_file &file = *files[file_i];
+
+      // We work with MC only
+      if (file.is_data == true) continue;
+
+
+      // Testing option: run over mc16a campaign only to save time
+      //if (file.campaign != "mc16a") continue;
+
+
+      // Select only jobs/physics_processes of our interest:
+      // (1) regular (not alternamtive) samples
+      // (2) tt+any, ttbb, ttb, ttc
+      if (file.ami_tag(1)!="s3126") continue;
+      // (3) listed in the table of samples
+      if (metadata.has(file.DID)==false) continue;
+      if (file.dir != previous_job) { cout << "\n\nDID: " << file.DID << " (" << metadata.info(file.DID).name << ", " << file.campaign << ")" << endl; }
+      previous_job = file.dir;
+
+
+      // Testing option: keep only tt+all if true
+      bool only_410472 = false;
+      //if (file.DID==410472) { only_410472=true; } else { continue; }
+
+
+      // The nominal tree and the trees of systematic variations
+      catalog.describe(file, tree_names);
+      if (file.sum_weights >= 0) metadata.add_sum_weights(file.DID, file.campaign, file.sum_weights);
+
+      mc_range prototype;
+      prototype.sample_DID = file.DID;
+      prototype.campaign = file.campaign;
+      prototype.norm_factor = 1;
+      prototype.topHFFF = metadata.info(file.DID).topHFFF;
+      prototype.only_410472 = only_410472;
+      prototype.from_skim = false;
+      prototype.is_data = false;
+      int n_before = ranges.size();
+      for (int tree_i=0; tree_i<tree_names.size(); tree_i++) { add_tree_ranges(ranges, file, tree_names[tree_i], entries_per_range, prototype); }
+      cout << file.path << "\n\t" << ranges.size() - n_before << " ranges" << endl;
+
+    } // [file_i] - loop over ntuples of all directories and jobs
+  catalog.write();
+
+
+  // Sums of weights are complete only now: resolve one normalisation per file
+  metadata.print();
+  for (int range_i=0; range_i<ranges.size(); range_i++) {
+    ranges[range_i].norm_factor = metadata.norm_factor(ranges[range_i].sample_DID, ranges[range_i].campaign); }
+
+  return ranges;
+}
+
+
+
+// ###################################################################
+// ## Ranges of entries of the data ntuples, one directory per year ##
+// ###################################################################
+//
+// Directories of the data periods (periodAllYear) hold the ntuples
+// directly. Data ranges have no sample, no normalisation and no topHFFF
+// filter, and only have the nominal tree.
+vector<mc_range> get_list_of_data_ranges(TString path_to_ntuples, Long64_t entries_per_range, TString catalog_path = "input_catalog.root")
+{
+  input_catalog catalog(catalog_path);
+  vector<catalog_file*> files = catalog.files_under(path_to_ntuples);
+  vector<mc_range> ranges;
+  for (int file_i=0; file_i<files.size(); file_i++) {
+    catalog_file &file = *files[file_i];
+    if (file.is_data == false) continue;
+    catalog.describe(file, {"nominal"});
+
+    mc_range prototype;
+    prototype.sample_DID = 0;
+    prototype.campaign = "";
+    prototype.norm_factor = 1;
+    prototype.topHFFF = -1;
+    prototype.only_410472 = false;
+    prototype.from_skim = false;
+    prototype.is_data = true;
+    int n_before = ranges.size();
+    add_tree_ranges(ranges, file, "nominal", entries_per_range, prototype);
+    cout << file.path << "\n\t" << ranges.size() - n_before << " ranges" << endl; }
+  catalog.write();
+
+  return ranges;
+}
+
+
+
+// ##############################################
+// ## Split a skim file into ranges of entries ##
+// ##############################################
+vector<mc_range> get_list_of_skim_ranges(TString skim_path, Long64_t entries_per_range)
+{
+  // DIDs and normalised weights are stored per event in skims
+  vector<mc_range> ranges;
+  TFile *skim = new TFile (skim_path);
+  TTree *tree_nominal = (TTree*)skim->Get("nominal");
+  FileStat_t skim_stat;
+  gSystem->GetPathInfo(skim_path, skim_stat);
+
+  vector<pair<Long64_t, Long64_t>> cluster_ranges = get_cluster_ranges(get_cluster_ends(tree_nominal), entries_per_range);
+  cout << skim_path << "\n\tEntries = " << tree_nominal->GetEntries() << " in " << cluster_ranges.size() << " ranges" << endl;
+  for (int range_i=0; range_i<cluster_ranges.size(); range_i++) {
+    Long64_t range_entries = cluster_ranges[range_i].second - cluster_ranges[range_i].first;
+    mc_range range;
+    range.path = skim_path;
+    range.file_size = skim_stat.fSize;
+    range.file_mtime = skim_stat.fMtime;
+    range.tree_name = "nominal";
+    range.sample_DID = 0;
+    range.campaign = "";
+    range.norm_factor = 1;
+    range.topHFFF = -1;
+    range.only_410472 = false;
+    range.from_skim = true;
+    range.is_data = false;
+    range.first = cluster_ranges[range_i].first;
+    range.last = cluster_ranges[range_i].second;
+    range.index = ranges.size();
+    range.size = tree_nominal->GetZipBytes() * range_entries / max(tree_nominal->GetEntries(), Long64_t(1));
+    ranges.push_back(range); }
+
+  skim->Close();
+  delete skim;
+
+  return ranges;
+}
+
+
+
+// #################################################
+// ## Branches of one event of the "nominal" tree ##
+// #################################################
+struct mc_event
+{
+  vector<Float_t> *jet_pt = 0, *jet_DL1r = 0, *jet_eta = 0, *jet_phi = 0, *jet_e = 0;
+  vector<Float_t> *el_pt = 0, *el_eta = 0, *el_cl_eta = 0, *el_phi = 0, *el_charge = 0, *el_e = 0;
+  vector<Float_t> *mu_pt = 0, *mu_eta = 0, *mu_phi = 0, *mu_charge = 0, *mu_e = 0;
+  vector<int> *topHadronOriginFlag = 0, *jet_truthflav = 0;
+  vector<char> *jet_DL1r_77 = 0;
+  Float_t met, met_phi;
+
+  // Weights
+  float w_mc, w_pu, w_leptonSF, w_DL1r_77, w_jvt;
+  UInt_t runNumber;
+  ULong64_t eventNumber = 0;
+
+  // Top flavor filter flag, -1 for data
+  int topHFFF = -1;
+
+  // Skims only: full event weight and DID of the sample
+  double weight_norm;
+  int sample_DID;
+
+
+  // Declare all the needed branches; skims carry the normalised
+  // event weight instead of the separate weights, data have neither
+  // weights nor truth branches. The branches of the cheap preselection
+  // are loaded first, see passes_preselection()
+  void declare(branch_manifest &branches, bool from_skim, bool is_data = false)
+  {
+    branches.read("jet_pt", &jet_pt);
+    branches.read("jet_eta", &jet_eta);
+    branches.read("jet_phi", &jet_phi);
+    branches.read("jet_e", &jet_e);
+    branches.read("jet_DL1r", &jet_DL1r);
+    branches.read_first("jet_isbtagged_DL1r_77", &jet_DL1r_77);
+    branches.read_first("el_pt", &el_pt);
+    branches.read("el_eta", &el_eta);
+    branches.read("el_cl_eta", &el_cl_eta);
+    branches.read("el_phi", &el_phi);
+    branches.read_first("el_charge", &el_charge);
+    branches.read("el_e", &el_e);
+    branches.read_first("mu_pt", &mu_pt);
+    branches.read("mu_eta", &mu_eta);
+    branches.read("mu_phi", &mu_phi);
+    branches.read_first("mu_charge", &mu_charge);
+    branches.read("mu_e", &mu_e);
+    branches.read("met_met", &met);
+    branches.read("met_phi", &met_phi);
+    branches.read("runNumber", &runNumber);
+    branches.read("eventNumber", &eventNumber);
+    if (is_data) return;
+
+    branches.read("jet_truthflav", &jet_truthflav);
+    branches.read("jet_GBHInit_topHadronOriginFlag", &topHadronOriginFlag); // https://gitlab.cern.ch/TTJ/Ntuple/-/blob/master/TTJNtuple/TTJNtuple/EventSaver.h#L55
+    branches.read_first("topHeavyFlavorFilterFlag", &topHFFF);
+
+    if (from_skim) {
+      branches.read("weight_norm", &weight_norm);
+      branches.read("sample_DID", &sample_DID); }
+    else {
+      branches.read("weight_mc", &w_mc);
+      branches.read("weight_pileup", &w_pu);
+      branches.read("weight_leptonSF", &w_leptonSF);
+      branches.read("weight_bTagSF_DL1r_77", &w_DL1r_77);
+      branches.read("weight_jvt", &w_jvt); }
+  }
+
+
+  // Product of the weights, optionally with one factor (see systematics.h)
+  // replaced by a varied value; multiplied in float as it always was
+  Float_t weight_product(int replaced_factor = -1, Float_t replacement = 1) const
+  {
+    return (replaced_factor==factor_mc ? replacement : w_mc) * (replaced_factor==factor_pileup ? replacement : w_pu)
+      * (replaced_factor==factor_leptonSF ? replacement : w_leptonSF) * (replaced_factor==factor_bTagSF_DL1r_77 ? replacement : w_DL1r_77)
+      * (replaced_factor==factor_jvt ? replacement : w_jvt);
+  }
+
+
+  // Create the branches of a skim tree, filled from this event
+  void book_skim_branches(TTree *skim_tree)
+  {
+    skim_tree->Branch("jet_pt", &jet_pt);
+    skim_tree->Branch("jet_eta", &jet_eta);
+    skim_tree->Branch("jet_phi", &jet_phi);
+    skim_tree->Branch("jet_e", &jet_e);
+    skim_tree->Branch("jet_DL1r", &jet_DL1r);
+    skim_tree->Branch("jet_isbtagged_DL1r_77", &jet_DL1r_77);
+    skim_tree->Branch("jet_truthflav", &jet_truthflav);
+    skim_tree->Branch("el_pt", &el_pt);
+    skim_tree->Branch("el_eta", &el_eta);
+    skim_tree->Branch("el_cl_eta", &el_cl_eta);
+    skim_tree->Branch("el_phi", &el_phi);
+    skim_tree->Branch("el_charge", &el_charge);
+    skim_tree->Branch("el_e", &el_e);
+    skim_tree->Branch("mu_pt", &mu_pt);
+    skim_tree->Branch("mu_eta", &mu_eta);
+    skim_tree->Branch("mu_phi", &mu_phi);
+    skim_tree->Branch("mu_charge", &mu_charge);
+    skim_tree->Branch("mu_e", &mu_e);
+    skim_tree->Branch("jet_GBHInit_topHadronOriginFlag", &topHadronOriginFlag);
+    skim_tree->Branch("met_met", &met, "met_met/F");
+    skim_tree->Branch("met_phi", &met_phi, "met_phi/F");
+    skim_tree->Branch("runNumber", &runNumber, "runNumber/i");
+    skim_tree->Branch("eventNumber", &eventNumber, "eventNumber/l");
+    skim_tree->Branch("topHeavyFlavorFilterFlag", &topHFFF, "topHeavyFlavorFilterFlag/I");
+    skim_tree->Branch("weight_norm", &weight_norm, "weight_norm/D");
+    skim_tree->Branch("sample_DID", &sample_DID, "sample_DID/I");
+  }
+};
+
+
+
+// ######################################
+// ## Selection cuts of the mc regions ##
+// ######################################
+struct mc_cuts
+{
+  bool emu_cut = false;
+  bool OS_cut = false;
+  bool jets_n_cut = false;
+  bool btags_n2_cut = false;
+  bool bjets_n2_cut = false;
+  bool bjets_n3_cut = false;
+  bool topHFFF_cut = false;
+};
+
+// Bits of the loosest selection of all the mc regions (emu, OS, >=3 jets, topHFFF)
+const UInt_t mc_preselection_bits = emu_bit | OS_bit | jets_n_bit | topHFFF_bit;
+
+
+// Selection bits computed from the branches declared with read_first() only;
+// the charges are only looked at in emu events
+UInt_t get_preselection_mask(const mc_event &ev, const mc_range &range)
+{
+  UInt_t mask = 0;
+  if ((*ev.el_pt).size()==1 && (*ev.mu_pt).size()==1) {
+    mask |= emu_bit;
+    if ((*ev.el_charge)[0]!=(*ev.mu_charge)[0]) mask |= OS_bit; }
+  if ((*ev.jet_DL1r_77).size()>=3) mask |= jets_n_bit;
+  int btags_n = 0;
+  for (int i=0; i<(*ev.jet_DL1r_77).size(); i++) { if ((*ev.jet_DL1r_77)[i]==1) btags_n++; }
+  if (btags_n >=2) mask |= btags_n2_bit;
+  if (range.from_skim==true || range.only_410472==true || range.topHFFF<0 || ev.topHFFF==range.topHFFF) mask |= topHFFF_bit;
+  return mask;
+}
+
+
+bool passes_preselection(const mc_event &ev, const mc_range &range)
+{
+  return (get_preselection_mask(ev, range) & mc_preselection_bits) == mc_preselection_bits;
+}
+
+// Data and mc share every reco-level cut; the truth cuts are compiled only
+// for mc, data events never pass them
+template <bool is_data = false>
+mc_cuts get_mc_cuts(const mc_event &ev, const mc_range &range)
+{
+  bool only_410472 = range.only_410472;
+  mc_cuts cuts;
+
+  // Define cuts themselves
+  if ((*ev.el_pt).size()==1 && (*ev.mu_pt).size()==1) cuts.emu_cut = true;
+  if ((*ev.el_charge)[0]!=(*ev.mu_charge)[0]) cuts.OS_cut = true;
+
+  if (is_data == false) {
+    int bjets_n = 0;
+    for (int i=0; i<(*ev.jet_pt).size(); i++) { if ( int((*ev.jet_truthflav)[i]==1) ) bjets_n++; }
+    if (bjets_n==3) cuts.bjets_n3_cut = true;
+    if (bjets_n>=2) cuts.bjets_n2_cut = true; }
+
+  int jets_n = (*ev.jet_pt).size();
+  if (jets_n >=3) cuts.jets_n_cut = true;
+
+  int btags_n = 0;
+  for (int i=0; i<(*ev.jet_pt).size(); i++) { if ((*ev.jet_DL1r_77)[i]==1) btags_n++; }
+  if (btags_n >=2) cuts.btags_n2_cut = true;
+
+  // Skims are written with the topHFFF cut applied already
+  if ( range.from_skim==true || only_410472==true || range.topHFFF<0 || ev.topHFFF==range.topHFFF ) cuts.topHFFF_cut = true;
+
+  return cuts;
+}
+
+
+
+// Pack all the cuts of an event
+UInt_t get_selection_mask(const mc_cuts &cuts)
+{
+  UInt_t mask = 0;
+  if (cuts.emu_cut) mask |= emu_bit;
+  if (cuts.OS_cut) mask |= OS_bit;
+  if (cuts.jets_n_cut) mask |= jets_n_bit;
+  if (cuts.btags_n2_cut) mask |= btags_n2_bit;
+  if (cuts.bjets_n2_cut) mask |= bjets_n2_bit;
+  if (cuts.bjets_n3_cut) mask |= bjets_n3_bit;
+  if (cuts.topHFFF_cut) mask |= topHFFF_bit;
+  return mask;
+}
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef NN_WRITER_H
+#define NN_WRITER_H
+
+#include <TTree.h>
+#include <TFile.h>
+#include <Compression.h>
+
+#include <vector>
+
+#include "mc_inputs.h"
+
+using namespace std;
+
+
+
+// #########################################################################
+// ## NN input tree of one range, concatenated into tt_jets_NN_input.root ##
+// #########################################################################
+//
+// The events of a range are written to its range shard (hist_shards.h),
+// flushed every flush_entries events, so memory stays at one cluster of
+// baskets per worker whatever the size of the dataset. The trees of the
+// ranges are then concatenated in range order. The jet branches are jagged
+// (one vector per event, in MeV as in the ntuples) and keep the ntuple
+// names; weight is the full event weight of the nominal histograms.
+class nn_writer
+{
+public:
+  // LZ4 decompresses fast for the repeated reads of the NN training
+  static int compression() { return ROOT::CompressionSettings(ROOT::kLZ4, 4); }
+
+
+  nn_writer(TFile *range_file, Long64_t flush_entries = 10000, int basket_size = 128000)
+  {
+    tree = new TTree("nominal", "NN_input");
+    tree->SetDirectory(range_file);
+    tree->SetAutoFlush(flush_entries);
+    tree->Branch("topHadronOriginFlag", &topHadronOriginFlag, basket_size);
+    tree->Branch("jet_truthflav", &jet_truthflav, basket_size);
+    tree->Branch("jet_pt", &jet_pt, basket_size);
+    tree->Branch("jet_eta", &jet_eta, basket_size);
+    tree->Branch("jet_phi", &jet_phi, basket_size);
+    tree->Branch("jet_e", &jet_e, basket_size);
+    tree->Branch("jet_DL1r", &jet_DL1r, basket_size);
+    tree->Branch("jet_isbtagged_DL1r_77", &jet_DL1r_77, basket_size);
+    tree->Branch("weight", &weight, "weight/D");
+    tree->Branch("runNumber", &runNumber, "runNumber/i");
+  }
+
+
+  // Add an event; the branches point to the buffers of the event being read
+  void fill(const mc_event &ev, double event_weight)
+  {
+    topHadronOriginFlag = ev.topHadronOriginFlag;
+    jet_truthflav = ev.jet_truthflav;
+    jet_pt = ev.jet_pt;
+    jet_eta = ev.jet_eta;
+    jet_phi = ev.jet_phi;
+    jet_e = ev.jet_e;
+    jet_DL1r = ev.jet_DL1r;
+    jet_DL1r_77 = ev.jet_DL1r_77;
+    weight = event_weight;
+    runNumber = ev.runNumber;
+    tree->Fill();
+  }
+
+
+  // Write the tree to the range file, once all the events are filled
+  void write() { tree->Write("", TObject::kOverwrite); }
+
+
+  Long64_t entries() const { return tree->GetEntries(); }
+
+
+private:
+  TTree *tree;
+
+  vector<int> *topHadronOriginFlag = 0, *jet_truthflav = 0;
+  vector<Float_t> *jet_pt = 0, *jet_eta = 0, *jet_phi = 0, *jet_e = 0, *jet_DL1r = 0;
+  vector<char> *jet_DL1r_77 = 0;
+  double weight = 0;
+  UInt_t runNumber = 0;
+};
+
+#endif
@@ -1,3 +1,21 @@
+#include <TFile.h>
+#include <TTree.h>
+#include <TGraph.h>
+#include <TLine.h>
+#include <TCanvas.h>
+#include <TLegend.h>
+#include <TStyle.h>
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+
+
 // ##############################################
 // ###   Draw 4 derived fractions from fits   ###
 // ##############################################
@@ -83,7 +101,7 @@ int draw_funcs(vector<double> vec_2b1l, vector<double> vec_4b, vector<double> ve
 
   gr_2b1l->GetYaxis()->SetRangeUser(0, 1);
   gr_2b1l->SetTitle("Fit results");
-  gr_2b1l->GetXaxis()->SetTitle("#bf{DL1r tag weight, 3rd tag}");
+  gr_2b1l->GetXaxis()->SetTitle("#bf{Expected events}");
   gr_2b1l->GetYaxis()->SetTitle("#bf{Fit fractions}");
   
   c1->Print("Plots/fit_results_plot_" + savename_ext + ".png");
@@ -97,23 +115,67 @@ int draw_funcs(vector<double> vec_2b1l, vector<double> vec_4b, vector<double> ve
 // ####################
 // #####   MAIN   #####
 // ####################
-void plot_fit_results()
+// Mean fitted fractions of the toys of run_toys.c versus the expected
+// events, one plot per set of true fractions, with the bias and pulls printed
+void plot_fit_results(TString results_path = "toy_results.root")
 {
-  vector<double> initial_fractions_1= {0.60, 0.10, 0.10, 0.20};
-  vector<double> norm_factors1 = {   1,    3,    5,    7,   10,   15};
-  vector<double> f_2b1l  =       {0.40, 0.47, 0.54, 0.54, 0.58, 0.58};
-  vector<double> f_4b    =       {0.09, 0.09, 0.09, 0.10, 0.10, 0.09};
-  vector<double> f_3b    =       {0.26, 0.22, 0.17, 0.17, 0.14, 0.14};
-  vector<double> f_2b1c  =       {0.24, 0.22, 0.20, 0.20, 0.18, 0.18};
-
-  vector<double> initial_fractions_2 = {0.60, 0.15, 0.15, 0.10};
-  vector<double> norm_factors2 = {   1,    3,    5,    7,   10,   15,   20,   30,   40,   50};
-  vector<double> s_2b1l  =       {0.47, 0.46, 0.54, 0.54, 0.56, 0.58, 0.58, 0.60, 0.60, 0.59};
-  vector<double> s_4b    =       {0.09, 0.12, 0.14, 0.14, 0.14, 0.14, 0.14, 0.15, 0.15, 0.15};
-  vector<double> s_3b    =       {0.22, 0.23, 0.18, 0.18, 0.17, 0.17, 0.18, 0.16, 0.16, 0.16};
-  vector<double> s_2b1c  =       {0.22, 0.18, 0.15, 0.15, 0.13, 0.11, 0.11, 0.10, 0.10, 0.10};
-  
-  
-  int plot_s = draw_funcs(s_2b1l, s_4b, s_3b, s_2b1c, norm_factors2, initial_fractions_2, "60_15_15_10");
-  int plot_f = draw_funcs(f_2b1l, f_4b, f_3b, f_2b1c, norm_factors1, initial_fractions_1, "60_10_10_20");
+  TFile *results_file = TFile::Open(results_path);
+  TTree *toys = (TTree*)results_file->Get("toys");
+  int config = 0, status = 0;
+  double n_events = 0, true_fractions[4], fractions[4], errors[4];
+  toys->SetBranchAddress("config", &config);
+  toys->SetBranchAddress("status", &status);
+  toys->SetBranchAddress("n_events", &n_events);
+  toys->SetBranchAddress("true_fractions", true_fractions);
+  toys->SetBranchAddress("fractions", fractions);
+  toys->SetBranchAddress("errors", errors);
+
+
+  // Sums over the converged toys of every configuration
+  map<int, vector<double>> configs_true;       // [config] 4 fractions, events
+  map<int, vector<double>> sum_fractions, sum_pulls, sum_pulls2;
+  map<int, Long64_t> n_converged;
+  for (Long64_t entry=0; entry<toys->GetEntries(); entry++) {
+    toys->GetEntry(entry);
+    if (configs_true.count(config)==0) {
+      configs_true[config] = {true_fractions[0], true_fractions[1], true_fractions[2], true_fractions[3], n_events};
+      sum_fractions[config] = vector<double>(4, 0);
+      sum_pulls[config] = vector<double>(4, 0);
+      sum_pulls2[config] = vector<double>(4, 0); }
+    if (status!=0) continue;
+    n_converged[config]++;
+    for (int i=0; i<4; i++) {
+      double pull = errors[i] > 0 ? (fractions[i] - true_fractions[i])/errors[i] : 0;
+      sum_fractions[config][i] += fractions[i];
+      sum_pulls[config][i] += pull;
+      sum_pulls2[config][i] += pull*pull; } }
+  results_file->Close();
+
+
+  // Group the configurations with the same true fractions, ordered by events
+  map<TString, vector<pair<double, int>>> groups;
+  for (map<int, vector<double>>::iterator it = configs_true.begin(); it != configs_true.end(); ++it) {
+    TString name = TString::Format("%.0f_%.0f_%.0f_%.0f", 100*it->second[0], 100*it->second[1], 100*it->second[2], 100*it->second[3]);
+    groups[name].push_back(make_pair(it->second[4], it->first)); }
+
+  vector<TString> processes = {"2b1l", "4b", "3b", "2b1c"};
+  for (map<TString, vector<pair<double, int>>>::iterator group = groups.begin(); group != groups.end(); ++group) {
+    sort(group->second.begin(), group->second.end());
+    vector<double> norm_factors, mean_fractions[4];
+    vector<double> initial_fractions(configs_true[group->second[0].second].begin(), configs_true[group->second[0].second].begin() + 4);
+    cout << "\nTrue fractions " << group->first << endl;
+    for (int point_i=0; point_i<group->second.size(); point_i++) {
+      int config_i = group->second[point_i].second;
+      double n = max(n_converged[config_i], Long64_t(1));
+      norm_factors.push_back(group->second[point_i].first);
+      cout << "  " << group->second[point_i].first << " events, " << n_converged[config_i] << " converged toys:";
+      for (int i=0; i<4; i++) {
+        double mean = sum_fractions[config_i][i]/n;
+        double pull_mean = sum_pulls[config_i][i]/n;
+        double pull_width = sqrt(max(sum_pulls2[config_i][i]/n - pull_mean*pull_mean, 0.));
+        mean_fractions[i].push_back(mean);
+        cout << "  " << processes[i] << " bias " << mean - initial_fractions[i] << " pull " << pull_mean << " +- " << pull_width; }
+      cout << endl; }
+
+    int plot = draw_funcs(mean_fractions[0], mean_fractions[1], mean_fractions[2], mean_fractions[3], norm_factors, initial_fractions, group->first); }
 }
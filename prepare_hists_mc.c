@@ -1,3 +1,4 @@
+#include <TROOT.h>
 #include <TH2.h>
 #include <TTree.h>
 #include <TFile.h>
@@ -9,862 +10,634 @@
 #include <TPad.h>
 #include <TMath.h>
 #include <TLorentzVector.h>
+#include <TStopwatch.h>
 
 #include <iostream>
 #include <sstream>
 #include <vector>
-
-#include "KLFitter/DetectorAtlas_8TeV.h"
-#include "KLFitter/Fitter.h"
-#include "KLFitter/LikelihoodTopDilepton.h"
-#include "KLFitter/Permutations.h"
+#include <thread>
+#include <mutex>
+#include <memory>
+#include <chrono>
+
+#include "work_scheduler.h"
+#include "branch_manifest.h"
+#include "mc_inputs.h"
+#include "event_kinematics.h"
+#include "selection_masks.h"
+#include "hist_registry.h"
+#include "hist_shards.h"
+#include "code_key.h"
+#include "nn_writer.h"
+#include "klfitter_reco.h"
+#include "klfitter_cache.h"
+#include "fast_reco.h"
 
 using namespace std;
 
 
 
-// ##################################
-// ## Split string into components ##
-// ##################################
-vector<TString> split(TString split_string, char delimiter)
-{
-  stringstream ss;
-  ss << split_string;
-  string component;
+// Workers share std::cout
+mutex cout_mutex;
 
-  vector<TString> container;
-  while(getline(ss, component, delimiter))
-    {
-      container.push_back(component);
-    }
 
-  return container;
-}
 
+// ###########################################
+// ## Regions of the mc and data histograms ##
+// ###########################################
+const UInt_t region_3b_emu_OS = emu_bit | OS_bit | bjets_n3_bit | topHFFF_bit | jets_n_bit;      // 3 truth b-jets
+const UInt_t region_2b_tags_emu_OS = emu_bit | OS_bit | btags_n2_bit | topHFFF_bit | jets_n_bit; // 2+ b-tags
+const UInt_t region_2b_emu_OS = emu_bit | OS_bit | bjets_n2_bit | topHFFF_bit | jets_n_bit;      // 2+ truth b-jets
 
 
-// #################################################
-// ## Make a list of files in the given directory ##
-// #################################################
-vector<TString> get_list_of_files(TString dirname, vector<TString> container = {})
-{
-  TSystemDirectory dir(dirname, dirname);
-  TList *files = dir.GetListOfFiles();
-  if (files) {
-    TSystemFile *file;
-    TString fname;
-    TIter next(files);
-    while ((file=(TSystemFile*)next())) {
-      fname = file->GetName();
-      if (fname != "." && fname != "..") {
-	if (fname.EndsWith(".root")) { container.push_back(dirname + fname); }
-	else { container.push_back(dirname + fname + "/"); }
-      }
-    }
-  }
-  return container;
-}
 
+// ##################################################
+// ## Observables of one event, computed only once ##
+// ##################################################
+// Data events only get the reco-level observables, the truth ones are
+// compiled for mc only
+struct mc_observables
+{
+  const mc_event *ev;          // branches of the event
+  const event_kinematics *kin; // leptons and jets in GeV with their pair matrices
+  int topHFFF;
+  int jets_n;
+  int lep0, lep1;              // leading and subleading lepton in kin: 0 electron, 1 muon
 
+  // dR_min between the leptons and bjets (3b) or btags (2b): [0] from top, [1] not from top
+  double min_dR_lep0_bjets[2], min_dR_lep1_bjets[2];
+  double min_dR_lep0_btags[2], min_dR_lep1_btags[2];
 
-// #####################
-// ## Compute delta R ##
-// #####################
-double dR(float phi_1st, float eta_1st, float phi_2nd, float eta_2nd)
-{
-  double dR_val = 0;
-  
-  double dPhi = phi_1st - phi_2nd;
-  double dEta = eta_1st - eta_2nd;
-  
-  if (dPhi > TMath::Pi()) dPhi = 2*TMath::Pi() - dPhi;
-
-  dR_val = sqrt( pow(dPhi,2) + pow(dEta,2) );
-  
-  return dR_val;
-}
+  // dR_min, 2b channel
+  double min_dR_b_from_top_to_b, min_dR_b_not_from_top_to_b, min_dR_not_b_to_b;
+  double min_dR_b_from_top_to_jet, min_dR_b_not_from_top_to_jet, min_dR_not_b_to_jet;
+  double min_dR_b_from_top_to_lep, min_dR_b_not_from_top_to_lep, min_dR_not_b_to_lep;
+
+  // Invariant masses of bjets and the closest lepton, one per bjet, 2b channel
+  vector<double> inv_mass_lep_bjet_from_top_min_dR, inv_mass_lep_bjet_not_from_top_min_dR;
+
+  // Min and max invariant masses of jets and leptons, 2b channel
+  double min_inv_mass_lep_bjet_from_top, max_inv_mass_lep_bjet_from_top;
+  double min_inv_mass_lep_bjet_not_from_top, max_inv_mass_lep_bjet_not_from_top;
+  double min_inv_mass_lep_other_jet, max_inv_mass_lep_other_jet;
+
+  // DL1r tag weights in decreasing order, 2b channel
+  vector<Float_t> DL1r_sorted;
+
+
+  // Compute what the regions passed by the event need
+  template <bool is_data>
+  void compute(UInt_t mask, const mc_event &event, const event_kinematics &kinematics)
+  {
+    ev = &event;
+    kin = &kinematics;
+    topHFFF = ev->topHFFF;
+    jets_n = kin->n_jets;
+
+    if ( (*ev->el_pt)[0] > (*ev->mu_pt)[0] ) { lep0 = 0; lep1 = 1; }
+    else { lep0 = 1; lep1 = 0; }
+    if (is_data) return;
+
+    const vector<int> &truthflav = *ev->jet_truthflav;
+    const vector<int> &tHOF = *ev->topHadronOriginFlag;
+    const vector<char> &DL1r_77 = *ev->jet_DL1r_77;
+
+    // dR1 is to the muon in both cases, as it always was
+    int lep_dR2 = (*ev->mu_pt)[0]>(*ev->el_pt)[0] ? 0 : 1;
+
+
+    // 3b, emu, OS channel: min_dR between leptons and bjets
+    if ((mask & region_3b_emu_OS) == region_3b_emu_OS) {
+      for (int i=0; i<2; i++) { min_dR_lep0_bjets[i] = 999999.; min_dR_lep1_bjets[i] = 999999.; }
+      for (int jet_i=0; jet_i<jets_n; jet_i++) {
+        if (truthflav[jet_i]!=5) continue;
+        int origin = tHOF[jet_i]==4 ? 0 : 1;
+        min_dR_lep0_bjets[origin] = min(min_dR_lep0_bjets[origin], kin->dR_jet_lep(jet_i, 1));
+        min_dR_lep1_bjets[origin] = min(min_dR_lep1_bjets[origin], kin->dR_jet_lep(jet_i, lep_dR2)); } }
+
+
+    // 2+b (tags), emu, OS: min_dR between leptons and btags
+    if ((mask & region_2b_tags_emu_OS) == region_2b_tags_emu_OS) {
+      for (int i=0; i<2; i++) { min_dR_lep0_btags[i] = 999999.; min_dR_lep1_btags[i] = 999999.; }
+      for (int jet_i=0; jet_i<jets_n; jet_i++) {
+        if (DL1r_77[jet_i]!=1) continue;
+        int origin = tHOF[jet_i]==4 ? 0 : 1;
+        min_dR_lep0_btags[origin] = min(min_dR_lep0_btags[origin], kin->dR_jet_lep(jet_i, 1));
+        min_dR_lep1_btags[origin] = min(min_dR_lep1_btags[origin], kin->dR_jet_lep(jet_i, lep_dR2)); } }
+
+
+    // 2+b (jets), emu, OS channel
+    if ((mask & region_2b_emu_OS) == region_2b_emu_OS) {
+
+      // Compute min dR for different jet-obj combinations
+      min_dR_b_from_top_to_b = min_dR_b_not_from_top_to_b = min_dR_not_b_to_b = 999999.;
+      min_dR_b_from_top_to_jet = min_dR_b_not_from_top_to_jet = min_dR_not_b_to_jet = 999999.;
+      min_dR_b_from_top_to_lep = min_dR_b_not_from_top_to_lep = min_dR_not_b_to_lep = 999999.;
+      for (int i=0; i<jets_n; i++) {
+        bool b_from_top = truthflav[i]==5 && tHOF[i]==4;
+        bool b_not_from_top = truthflav[i]==5 && tHOF[i]!=4;
+        bool not_b = truthflav[i]!=5 && tHOF[i]!=4;
+
+        for (int j=0; j<jets_n; j++) {
+          if (i==j) continue;
+          double dR = kin->dR_jet_jet(i, j);
+          if (truthflav[j]==5) {
+            if (b_from_top) min_dR_b_from_top_to_b = min(min_dR_b_from_top_to_b, dR);
+            if (b_not_from_top) min_dR_b_not_from_top_to_b = min(min_dR_b_not_from_top_to_b, dR);
+            if (not_b) min_dR_not_b_to_b = min(min_dR_not_b_to_b, dR); }
+          else {
+            if (b_from_top) min_dR_b_from_top_to_jet = min(min_dR_b_from_top_to_jet, dR);
+            if (b_not_from_top) min_dR_b_not_from_top_to_jet = min(min_dR_b_not_from_top_to_jet, dR);
+            if (not_b) min_dR_not_b_to_jet = min(min_dR_not_b_to_jet, dR); } }
+
+        double dR_lep = min(kin->dR_jet_lep(i, 0), kin->dR_jet_lep(i, 1));
+        if (b_from_top) min_dR_b_from_top_to_lep = min(min_dR_b_from_top_to_lep, dR_lep);
+        if (b_not_from_top) min_dR_b_not_from_top_to_lep = min(min_dR_b_not_from_top_to_lep, dR_lep);
+        if (not_b) min_dR_not_b_to_lep = min(min_dR_not_b_to_lep, dR_lep); }
+
+
+      // Invariant mass of bjet-lepton pairs
+      inv_mass_lep_bjet_from_top_min_dR.clear();
+      inv_mass_lep_bjet_not_from_top_min_dR.clear();
+      min_inv_mass_lep_bjet_from_top = 999999;
+      max_inv_mass_lep_bjet_from_top = 0;
+      min_inv_mass_lep_bjet_not_from_top = 999999;
+      max_inv_mass_lep_bjet_not_from_top = 0;
+      min_inv_mass_lep_other_jet = 999999;
+      max_inv_mass_lep_other_jet = 0;
+      for (int jet_i=0; jet_i<jets_n; jet_i++) {
+        double mass_el = kin->mass_jet_lep(jet_i, 0);
+        double mass_mu = kin->mass_jet_lep(jet_i, 1);
+
+        // bjets and the closest leptons, min and max invariant masses; the max for
+        // bjets from top and both values for other jets keep the last jet, as they always did
+        if (truthflav[jet_i]==5) {
+          double inv_mass_j_lep = kin->dR_jet_lep(jet_i, 0) <= kin->dR_jet_lep(jet_i, 1) ? mass_el : mass_mu;
+          if (tHOF[jet_i]==4) {
+            if (inv_mass_j_lep != 0) inv_mass_lep_bjet_from_top_min_dR.push_back(inv_mass_j_lep);
+            min_inv_mass_lep_bjet_from_top = min(min(mass_el, mass_mu), min_inv_mass_lep_bjet_from_top);
+            max_inv_mass_lep_bjet_from_top = mass_mu; }
+          else {
+            if (inv_mass_j_lep != 0) inv_mass_lep_bjet_not_from_top_min_dR.push_back(inv_mass_j_lep);
+            min_inv_mass_lep_bjet_not_from_top = min(min(mass_el, mass_mu), min_inv_mass_lep_bjet_not_from_top);
+            max_inv_mass_lep_bjet_not_from_top = max(max(mass_el, mass_mu), max_inv_mass_lep_bjet_not_from_top); } }
+        else {
+          min_inv_mass_lep_other_jet = min(mass_el, mass_mu);
+          max_inv_mass_lep_other_jet = max(mass_el, mass_mu); } }
+
+
+      // Sort jets wrt DL1r tag weights
+      DL1r_sorted.assign(ev->jet_DL1r->begin(), ev->jet_DL1r->end());
+      sort (DL1r_sorted.begin(), DL1r_sorted.end(), greater<int>()); }
+  }
+};
 
 
 
-// ##############
-// ##   MAIN   ##
-// ##############
-void prepare_hists_mc()
+// #############################################################
+// ## Define all the mc and data histograms and their regions ##
+// #############################################################
+void define_hists(hist_registry<mc_observables> &registry)
 {
-  // Create a list of directories with ntuples
-  TString path_to_ntuples = "/eos/user/e/eantipov/Files/tt_hf/";
-  vector<TString> dir_paths = get_list_of_files(path_to_ntuples);
+  typedef const mc_observables &obs;
+  typedef vector<double> &x;
+  const int n_processes = 4;
+  TString processes[n_processes] = {"2b1l", "4b", "3b", "2b1c"}; // indexed by topHFFF
 
-  
-  // Declare histograms
-  
   // dR_min between bjets and leptons, 3b channel
-  TH1 *h_minDeltaR_lep0_bjets_from_top = new TH1F("minDeltaR_lep1_bjets_fromTop", "minDeltaR_lep1_bjets_fromTop", 20, 0, 5);
-  TH1 *h_minDeltaR_lep0_bjets_not_from_top = new TH1F("minDeltaR_lep1_bjets_notFromTop", "minDeltaR_lep1_bjets_notFromTop", 20, 0, 5);
-  TH1 *h_minDeltaR_lep1_bjets_from_top = new TH1F("minDeltaR_lep2_bjets_fromTop", "minDeltaR_lep2_bjets_fromTop", 20, 0, 5);
-  TH1 *h_minDeltaR_lep1_bjets_not_from_top = new TH1F("minDeltaR_lep2_bjets_notFromTop", "minDeltaR_lep2_bjets_notFromTop", 20, 0, 5);
-  
+  registry.define("3b_emu_OS_min_dR_lep0_b_from_top", 20, 0, 5, region_3b_emu_OS, [](obs o, x v) { v.push_back(o.min_dR_lep0_bjets[0]); });
+  registry.define("3b_emu_OS_min_dR_lep1_b_from_top", 20, 0, 5, region_3b_emu_OS, [](obs o, x v) { v.push_back(o.min_dR_lep1_bjets[0]); });
+  registry.define("3b_emu_OS_min_dR_lep0_b_not_from_top", 20, 0, 5, region_3b_emu_OS, [](obs o, x v) { v.push_back(o.min_dR_lep0_bjets[1]); });
+  registry.define("3b_emu_OS_min_dR_lep1_b_not_from_top", 20, 0, 5, region_3b_emu_OS, [](obs o, x v) { v.push_back(o.min_dR_lep1_bjets[1]); });
+
   // dR_min between btags and leptons, 2b channel
-  TH1 *h_minDeltaR_lep0_btags_from_top = new TH1F("h_minDeltaR_lep0_btags_from_top", "h_minDeltaR_lep0_btags_from_top", 20, 0, 5);
-  TH1 *h_minDeltaR_lep0_btags_not_from_top = new TH1F("h_minDeltaR_lep0_btags_not_from_top", "h_minDeltaR_lep0_btags_not_from_top", 20, 0, 5);;
-  TH1 *h_minDeltaR_lep1_btags_from_top = new TH1F("h_minDeltaR_lep1_btags_from_top", "h_minDeltaR_lep1_btags_from_top", 20, 0, 5);
-  TH1 *h_minDeltaR_lep1_btags_not_from_top = new TH1F("h_minDeltaR_lep1_btags_not_from_top", "h_minDeltaR_lep1_btags_not_from_top", 20, 0, 5);
-  
-  // dR_min, 2b channel 
-  TH1 *h_minDeltaR_b_from_top_to_b = new TH1F("h_minDeltaR_b_from_top_to_b", "h_minDeltaR_b_from_top_to_b", 20, 0, 5);
-  TH1 *h_minDeltaR_b_not_from_top_to_b = new TH1F("h_minDeltaR_b_not_from_top_to_b", "h_minDeltaR_b_not_from_top_to_b", 20, 0, 5);
-  TH1 *h_minDeltaR_not_b_to_b = new TH1F("h_minDeltaR_not_b_to_b", "h_minDeltaR_not_b_to_b", 20, 0, 5);
-  TH1 *h_minDeltaR_b_from_top_to_jet = new TH1F("h_minDeltaR_b_from_top_to_jet", "h_minDeltaR_b_from_top_to_jet", 20, 0, 5);
-  TH1 *h_minDeltaR_b_not_from_top_to_jet = new TH1F("h_minDeltaR_b_not_from_top_to_jet", "h_minDeltaR_b_not_from_top_to_jet", 20, 0, 5);
-  TH1 *h_minDeltaR_not_b_to_jet = new TH1F("h_minDeltaR_not_b_to_jet", "h_minDeltaR_not_b_to_jet", 20, 0, 5);
-  TH1 *h_minDeltaR_b_from_top_to_lep = new TH1F("h_minDeltaR_b_from_top_to_lep", "h_minDeltaR_b_from_top_to_lep", 20, 0, 5);
-  TH1 *h_minDeltaR_b_not_from_top_to_lep = new TH1F("h_minDeltaR_b_not_from_top_to_lep", "h_minDeltaR_b_not_from_top_to_lep", 20, 0, 5);
-  TH1 *h_minDeltaR_not_b_to_lep = new TH1F("h_minDeltaR_not_b_to_lep", "h_minDeltaR_not_b_to_lep", 20, 0, 5);
-  
-  // pT of the three leading jets, 2b channel
-  TH1 *h_jet_pt[3];
-  for (int i=0; i<3; i++) {
-      TString title = "jet_pt_" + to_string(i);
-      h_jet_pt[i] = new TH1F(title, title, 100, 0, 1000); }
- 
+  registry.define("2b_emu_OS_min_dR_lep0_b_from_top", 20, 0, 5, region_2b_tags_emu_OS, [](obs o, x v) { v.push_back(o.min_dR_lep0_btags[0]); });
+  registry.define("2b_emu_OS_min_dR_lep1_b_from_top", 20, 0, 5, region_2b_tags_emu_OS, [](obs o, x v) { v.push_back(o.min_dR_lep1_btags[0]); });
+  registry.define("2b_emu_OS_min_dR_lep0_b_not_from_top", 20, 0, 5, region_2b_tags_emu_OS, [](obs o, x v) { v.push_back(o.min_dR_lep0_btags[1]); });
+  registry.define("2b_emu_OS_min_dR_lep1_b_not_from_top", 20, 0, 5, region_2b_tags_emu_OS, [](obs o, x v) { v.push_back(o.min_dR_lep1_btags[1]); });
+
+  // dR_min, 2b channel
+  registry.define("2b_emu_OS_minDeltaR_b_from_top_to_b", 20, 0, 5, region_2b_emu_OS, [](obs o, x v) { v.push_back(o.min_dR_b_from_top_to_b); });
+  registry.define("2b_emu_OS_minDeltaR_b_not_from_top_to_b", 20, 0, 5, region_2b_emu_OS, [](obs o, x v) { v.push_back(o.min_dR_b_not_from_top_to_b); });
+  registry.define("2b_emu_OS_minDeltaR_not_b_to_b", 20, 0, 5, region_2b_emu_OS, [](obs o, x v) { v.push_back(o.min_dR_not_b_to_b); });
+  registry.define("2b_emu_OS_minDeltaR_b_from_top_to_jet", 20, 0, 5, region_2b_emu_OS, [](obs o, x v) { v.push_back(o.min_dR_b_from_top_to_jet); });
+  registry.define("2b_emu_OS_minDeltaR_b_not_from_top_to_jet", 20, 0, 5, region_2b_emu_OS, [](obs o, x v) { v.push_back(o.min_dR_b_not_from_top_to_jet); });
+  registry.define("2b_emu_OS_minDeltaR_not_b_to_jet", 20, 0, 5, region_2b_emu_OS, [](obs o, x v) { v.push_back(o.min_dR_not_b_to_jet); });
+  registry.define("2b_emu_OS_minDeltaR_b_from_top_to_lep", 20, 0, 5, region_2b_emu_OS, [](obs o, x v) { v.push_back(o.min_dR_b_from_top_to_lep); });
+  registry.define("2b_emu_OS_minDeltaR_b_not_from_top_to_lep", 20, 0, 5, region_2b_emu_OS, [](obs o, x v) { v.push_back(o.min_dR_b_not_from_top_to_lep); });
+  registry.define("2b_emu_OS_minDeltaR_not_b_to_lep", 20, 0, 5, region_2b_emu_OS, [](obs o, x v) { v.push_back(o.min_dR_not_b_to_lep); });
+
+  // pT of the leading jets, 2b channel
+  for (int i=0; i<6; i++) {
+    registry.define("2b_emu_OS_jet_pt" + to_string(i), 100, 0, 1000, region_2b_tags_emu_OS, [i](obs o, x v) { if (i < o.jets_n) v.push_back(o.kin->jet_pt[i]); }); }
+
   // the first three DL1r tag distributions for 2b1l / 4b / 3b / 2b1c, 2b channel
-  TH1 *h_tag0_DL1r[4];
-  TH1 *h_tag1_DL1r[4];
-  TH1 *h_tag2_DL1r[4];
-  for (int i=0; i<4; i++) {
-      TString h_title0 = "h_tag0_DL1r_TopHFFF" + to_string(i);
-      TString h_title1 = "h_tag1_DL1r_TopHFFF" + to_string(i);
-      TString h_title2 = "h_tag2_DL1r_TopHFFF" + to_string(i);
-      h_tag0_DL1r[i] = new TH1F(h_title0, h_title0, 30, -15, 15);
-      h_tag1_DL1r[i] = new TH1F(h_title1, h_title1, 30, -15, 15);
-      h_tag2_DL1r[i] = new TH1F(h_title2, h_title2, 30, -15, 15); }
+  for (int topHFFF_i=0; topHFFF_i<n_processes; topHFFF_i++) {
+    TString process = processes[topHFFF_i];
+    registry.define("DL1r_templates_"+process+"_1st_tag", 30, -15, 15, region_2b_emu_OS, [topHFFF_i](obs o, x v) { if (o.topHFFF==topHFFF_i) v.push_back(o.DL1r_sorted[0]); });
+    registry.define("DL1r_templates_"+process+"_2nd_tag", 30, -15, 15, region_2b_emu_OS, [topHFFF_i](obs o, x v) { if (o.topHFFF==topHFFF_i) v.push_back(o.DL1r_sorted[1]); });
+    registry.define("DL1r_templates_"+process+"_3rd_tag", 30, -15, 15, region_2b_emu_OS, [topHFFF_i](obs o, x v) { if (o.topHFFF==topHFFF_i) v.push_back(o.DL1r_sorted[2]); }); }
 
   // MET, 2b channel
-  TH1 *h_met = new TH1F("h_met", "h_met", 20, 0, 1000);
-  TH1 *h_met_phi = new TH1F("h_met_phi", "h_met_phi", 40, -4, 4);
+  registry.define("2b_emu_OS_met", 20, 0, 1000, region_2b_tags_emu_OS, [](obs o, x v) { v.push_back(o.ev->met*0.001); });
+  registry.define("2b_emu_OS_met_phi", 40, -4, 4, region_2b_tags_emu_OS, [](obs o, x v) { v.push_back(o.ev->met_phi); });
+
+  // bjets_n (all jets are counted), 2b channel, also per process
+  registry.define("2b_emu_OS_bjets_n", 4, 0, 4, region_2b_tags_emu_OS, [](obs o, x v) { v.push_back(o.jets_n); });
+  for (int topHFFF_i=0; topHFFF_i<n_processes; topHFFF_i++) {
+    registry.define("2b_emu_OS_bjets_n_"+processes[topHFFF_i], 4, 0, 4, region_2b_tags_emu_OS, [topHFFF_i](obs o, x v) { if (o.topHFFF==topHFFF_i) v.push_back(o.jets_n); }); }
 
-  // bjets_n, 2b channel
-  TH1 *h_bjets_n = new TH1F("h_bjets_n", "h_bjets_n", 4, 0, 4);
-  
   // leptons, 2b channel
-  TH1 *h_lep0_pt = new TH1F("h_lep0_pt", "h_lep0_pt", 20, 0, 1000);
-  TH1 *h_lep1_pt = new TH1F("h_lep1_pt", "h_lep1_pt", 20, 0, 1000);
-  TH1 *h_lep_pt = new TH1F("h_lep_pt", "h_lep_pt", 20, 0, 1000);
-  TH1 *h_lep0_eta = new TH1F("h_lep0_eta", "h_let0_eta", 20, -5, 5);
-  TH1 *h_lep1_eta = new TH1F("h_lep1_eta", "h_lep1_eta", 20, -5, 5);
-  TH1 *h_lep_eta = new TH1F("h_lep_eta", "h_lep_eta", 20, -5, 5);
-  TH1 *h_lep0_phi = new TH1F("h_lep0_phi", "h_lep0_phi", 40, -4, 4);
-  TH1 *h_lep1_phi = new TH1F("h_lep1_phi", "h_lep1_phi", 40, -4, 4);
-  TH1 *h_lep_phi = new TH1F("h_lep_phi", "h_lep_phi", 40, -4, 4);
-  TH1 *h_dR_lep0_lep1 = new TH1F("h_dR_lep0_lep1", "h_dR_lep0_lep1", 20, 0, 5);
-  
-  // Invariant mass, 2b channel
-  TH1 *h_inv_mass_lep_bjet_from_top_min_dR = new TH1F("h_inv_mass_lep_bjet_from_top_min_dR", "h_inv_mass_lep_bjet_from_top_min_dR", 1000, 0, 1000);
-  TH1 *h_inv_mass_lep_bjet_not_from_top_min_dR = new TH1F("h_inv_mass_lep_bjet_not_from_top_min_dR", "h_inv_mass_lep_bjet_not_from_top_min_dR", 1000, 0, 1000);
-  TH1 *h_inv_mass_lep_btag_from_top_min_dR = new TH1F("h_inv_mass_lep_btag_from_top_min_dR", "h_inv_mass_lep_btag_from_top_min_dR", 1000, 0, 1000);
-  TH1 *h_inv_mass_lep_btag_not_from_top_min_dR = new TH1F("h_inv_mass_lep_btag_not_from_top_min_dR", "h_inv_mass_lep_btag_not_from_top_min_dR", 1000, 0, 1000);
-  TH1 *h_min_inv_mass_lep_bjet_from_top = new TH1F("h_min_inv_mass_lep_bjet_from_top", "h_min_inv_mass_lep_bjet_from_top", 1000, 0, 1000);
-  TH1 *h_max_inv_mass_lep_bjet_from_top = new TH1F("h_max_inv_mass_lep_bjet_from_top", "h_max_inv_mass_lep_bjet_from_top", 1000, 0, 1000);
-  TH1 *h_min_inv_mass_lep_bjet_not_from_top = new TH1F("h_min_inv_mass_lep_bjet_not_from_top", "h_min_inv_mass_lep_bjet_not_from_top", 1000, 0, 1000);
-  TH1 *h_max_inv_mass_lep_bjet_not_from_top = new TH1F("h_max_inv_mass_lep_bjet_not_from_top", "h_max_inv_mass_lep_bjet_not_from_top", 1000, 0, 1000);
-  TH1 *h_min_inv_mass_lep_other_jet = new TH1F("h_min_inv_mass_lep_other_jet", "h_min_inv_mass_lep_other_jet", 1000, 0, 1000);
-  TH1 *h_max_inv_mass_lep_other_jet = new TH1F("h_max_inv_mass_lep_other_jet", "h_max_inv_mass_lep_other_jet", 1000, 0, 1000);
-
-  // Initialize KLFitter
-  KLFitter::Fitter fitter{};
-  
-  KLFitter::DetectorAtlas_8TeV detector{"/cvmfs/atlas.cern.ch/repo/sw/database/GroupData/dev/AnalysisTop/KLFitterTFs/mc15c/akt4_EMtopo_PP6"};
-  fitter.SetDetector(&detector);
-
-  KLFitter::LikelihoodTopDilepton likelihood{};
-  likelihood.PhysicsConstants()->SetMassTop(172.5);
-  likelihood.SetBTagging(KLFitter::LikelihoodBase::BtaggingMethod::kNotag);
-  likelihood.SetFlagTopMassFixed(true);
-  fitter.SetLikelihood(&likelihood);
-
-
-  // Create a ROOT file for NN
-  vector<vector<int>> NN_tHOF_v, NN_jet_truthflav_v;
-
-
-  // Loop over directories with ntuples collections
-  for (int dir_counter=0; dir_counter<dir_paths.size(); dir_counter++)
+  registry.define("2b_emu_OS_lep0_pt", 20, 0, 1000, region_2b_tags_emu_OS, [](obs o, x v) { v.push_back(o.kin->lep_pt[o.lep0]); });
+  registry.define("2b_emu_OS_lep1_pt", 20, 0, 1000, region_2b_tags_emu_OS, [](obs o, x v) { v.push_back(o.kin->lep_pt[o.lep1]); });
+  registry.define("2b_emu_OS_lep_pt", 20, 0, 1000, region_2b_tags_emu_OS, [](obs o, x v) { v.push_back(o.kin->lep_pt[0]); v.push_back(o.kin->lep_pt[1]); });
+  registry.define("2b_emu_OS_lep0_eta", 20, -5, 5, region_2b_tags_emu_OS, [](obs o, x v) { v.push_back(o.kin->lep_eta[o.lep0]); });
+  registry.define("2b_emu_OS_lep1_eta", 20, -5, 5, region_2b_tags_emu_OS, [](obs o, x v) { v.push_back(o.kin->lep_eta[o.lep1]); });
+  registry.define("2b_emu_OS_lep_eta", 20, -5, 5, region_2b_tags_emu_OS, [](obs o, x v) { v.push_back(o.kin->lep_eta[0]); v.push_back(o.kin->lep_eta[1]); });
+  registry.define("2b_emu_OS_lep0_phi", 40, -4, 4, region_2b_tags_emu_OS, [](obs o, x v) { v.push_back(o.kin->lep_phi[o.lep0]); });
+  registry.define("2b_emu_OS_lep1_phi", 40, -4, 4, region_2b_tags_emu_OS, [](obs o, x v) { v.push_back(o.kin->lep_phi[o.lep1]); });
+  registry.define("2b_emu_OS_lep_phi", 40, -4, 4, region_2b_tags_emu_OS, [](obs o, x v) { v.push_back(o.kin->lep_phi[0]); v.push_back(o.kin->lep_phi[1]); });
+  registry.define("2b_emu_OS_dR_lep0_lep1", 20, 0, 5, region_2b_tags_emu_OS, [](obs o, x v) { v.push_back(o.kin->dR_lep_lep()); });
+
+  // Invariant mass, 2b channel; the btag ones are not filled yet
+  registry.define("2b_emu_OS_inv_mass_lep_bjet_from_top_min_dR", 1000, 0, 1000, region_2b_emu_OS, [](obs o, x v) { v.insert(v.end(), o.inv_mass_lep_bjet_from_top_min_dR.begin(), o.inv_mass_lep_bjet_from_top_min_dR.end()); });
+  registry.define("2b_emu_OS_inv_mass_lep_bjet_not_from_top_min_dR", 1000, 0, 1000, region_2b_emu_OS, [](obs o, x v) { v.insert(v.end(), o.inv_mass_lep_bjet_not_from_top_min_dR.begin(), o.inv_mass_lep_bjet_not_from_top_min_dR.end()); });
+  registry.define("2b_emu_OS_inv_mass_lep_btag_from_top_min_dR", 1000, 0, 1000, region_2b_emu_OS, [](obs o, x v) { });
+  registry.define("2b_emu_OS_inv_mass_lep_btag_not_from_top_min_dR", 1000, 0, 1000, region_2b_emu_OS, [](obs o, x v) { });
+  registry.define("2b_emu_OS_min_inv_mass_lep_bjet_from_top", 1000, 0, 1000, region_2b_emu_OS, [](obs o, x v) { if (o.min_inv_mass_lep_bjet_from_top!=999999) v.push_back(o.min_inv_mass_lep_bjet_from_top); });
+  registry.define("2b_emu_OS_max_inv_mass_lep_bjet_from_top", 1000, 0, 1000, region_2b_emu_OS, [](obs o, x v) { if (o.max_inv_mass_lep_bjet_from_top!=0) v.push_back(o.max_inv_mass_lep_bjet_from_top); });
+  registry.define("2b_emu_OS_min_inv_mass_lep_bjet_not_from_top", 1000, 0, 1000, region_2b_emu_OS, [](obs o, x v) { if (o.min_inv_mass_lep_bjet_not_from_top!=999999) v.push_back(o.min_inv_mass_lep_bjet_not_from_top); });
+  registry.define("2b_emu_OS_max_inv_mass_lep_bjet_not_from_top", 1000, 0, 1000, region_2b_emu_OS, [](obs o, x v) { if (o.max_inv_mass_lep_bjet_not_from_top!=0) v.push_back(o.max_inv_mass_lep_bjet_not_from_top); });
+  registry.define("2b_emu_OS_min_inv_mass_lep_other_jet", 1000, 0, 1000, region_2b_emu_OS, [](obs o, x v) { if (o.min_inv_mass_lep_other_jet!=999999) v.push_back(o.min_inv_mass_lep_other_jet); });
+  registry.define("2b_emu_OS_max_inv_mass_lep_other_jet", 1000, 0, 1000, region_2b_emu_OS, [](obs o, x v) { if (o.max_inv_mass_lep_other_jet!=0) v.push_back(o.max_inv_mass_lep_other_jet); });
+
+  // Histograms with a copy per systematic variation (systematics.txt)
+  registry.vary("DL1r_templates_");
+  registry.vary("2b_emu_OS_jet_pt");
+  registry.vary("2b_emu_OS_met");
+  registry.vary("2b_emu_OS_bjets_n");
+
+  // Histograms of truth regions or split by truth, not booked for data
+  registry.mc_only(truth_bits);
+  registry.mc_only("2b_emu_OS_min_dR_lep");
+  registry.mc_only("2b_emu_OS_bjets_n_");
+}
+
+
+
+// ###################################################
+// ## Process a range of entries of a single ntuple ##
+// ###################################################
+// The same core runs over mc and data: for data (is_data) the truth,
+// weights, systematics, NN input and reconstruction are compiled out, and
+// every event has weight 1
+template <bool is_data>
+Long64_t process_range(const mc_range &range, const systematics_config &systematics, const TString &cut_key, hist_bank<mc_observables> &bank, nn_writer *NN_writer, klf_reco *klf, mlb_reco *mlb, klf_writer *reco_out, Long64_t &bytes_skipped)
+{
+  // Open ntuple
+  { lock_guard<mutex> lock(cout_mutex);
+    cout << range.path << " " << range.tree_name << "\t[" << range.first << ", " << range.last << ")" << endl; }
+  TFile *ntuple = new TFile (range.path);
+  TTree *tree_nominal = (TTree*)ntuple->Get(range.tree_name);
+
+
+  // The nominal tree fills the nominal and all the weight variations in one
+  // read, the trees of systematic variations fill only their own histograms
+  bool nominal = range.tree_name == "nominal";
+  int variation = 0;
+  for (int tree_i=0; tree_i<systematics.trees.size(); tree_i++) {
+    if (systematics.trees[tree_i] == range.tree_name) variation = systematics.first_tree_variation() + tree_i; }
+  vector<weight_variation> weight_variations;
+  if (!is_data && nominal && range.from_skim==false) weight_variations = systematics.weights;
+  vector<double> weights(1 + weight_variations.size());
+
+
+  // Declare all the needed branches
+  branch_manifest branches;
+  mc_event ev;
+  ev.declare(branches, range.from_skim, is_data);
+  for (int var_i=0; var_i<weight_variations.size(); var_i++) { weight_variations[var_i].declare(branches); }
+
+
+  // Ignore the "ReadStreamerInfo, class:string, illegal uid=-2" erro
+
+
+  // Read only the declared branches, through a cache trained on them
+  branches.attach(tree_nominal, range.first, range.last);
+
+
+  // Kinematics and observables buffers reused by all the events of the range
+  event_kinematics kin;
+  mc_observables obs;
+
+
+  // Cut results of an earlier run over the range with the same ntuple, cuts
+  // and sample selection (topHFFF of sample_metadata.txt, 410472 only), if any
+  TString mask_key = to_string(range.file_size) + " " + to_string(range.file_mtime) + " " + cut_key + " topHFFF" + to_string(range.topHFFF)
+                     + (range.only_410472 ? " only_410472" : "");
+  selection_masks masks(range.path, range.first, range.last, range.tree_name, mask_key);
+  masks.read();
+  UInt_t b_bits = btags_n2_bit | bjets_n2_bit | bjets_n3_bit;
+
+
+  // KLFitter results of earlier runs over the range, if any
+  unique_ptr<klf_cache> klf_results;
+  if (!is_data && klf) {
+    klf_results.reset(new klf_cache(range.path, range.first, range.last, range.tree_name, klf->config_key()));
+    klf_results->read(); }
+
+
+  // Loop over entries of the range
+  for (Long64_t entry=range.first; entry<range.last; entry++)
     {
-      // Announce current directory
-      cout << "\n\n\n" << dir_paths[dir_counter] << endl;
-      
-
-      // Check for the content: data/mc? which campaign?
-      vector<TString> dir_path_components = split(dir_paths[dir_counter], '/');
-      int last_element_index = dir_path_components.size();
-      vector<TString> dir_name_components = split(dir_path_components[last_element_index-1], '_');
-      bool is_data = false;
-      bool is_2015 = false;
-      bool is_2016 = false;
-      bool is_2017 = false;
-      bool is_2018 = false;
-      bool is_mc16a = false;
-      bool is_mc16d = false;
-      bool is_mc16e = false;
-      for (int i=0; i<dir_name_components.size(); i++)
-	{
-	  if (dir_name_components[i] == "data") is_data = true;
-          if (dir_name_components[i] == "2015") is_2015 = true;
-          if (dir_name_components[i] == "2016") is_2016 = true;
-          if (dir_name_components[i] == "2017") is_2017 = true;
-          if (dir_name_components[i] == "2018") is_2018 = true;
-          if (dir_name_components[i] == "mc16a") is_mc16a = true;
-          if (dir_name_components[i] == "mc16d") is_mc16d = true;
-          if (dir_name_components[i] == "mc16e") is_mc16e = true;
-	}
-      
-      
-      // We work with MC only
-      if (is_data == true) continue;
-      
-
-      // Testing option: run over mc16a campaign only to save time
-      //if (is_mc16a != true) continue;
-      
-
-      // Make a list of paths to jobs/DIDs outputs (pieces of a full ntuple)
-      vector<TString> paths_to_jobs = get_list_of_files(dir_paths[dir_counter]);
-
-
-      // Loop over jobs/DIDs
-      for (int job_number=0; job_number<paths_to_jobs.size(); job_number++)
-	{
-	  // Get info about the job/DID from its name
-	  vector<TString> path_to_jobs_components = split(paths_to_jobs[job_number], '/');
-	  TString job_name = path_to_jobs_components[path_to_jobs_components.size() - 1];
-	  vector<TString> job_name_components = split(job_name, '.');
-	  TString job_DID = job_name_components[2];
-	  vector<TString> campaign_info = split(job_name_components[5], '_');
-
-	  
-	  // Select only jobs/physics_processes of our interest: 
-	  // (1) regular (not alternamtive) samples
-	  // (2) tt+any, ttbb, ttb, ttc
-	  if (campaign_info[1]!="s3126") continue;
-	  if (job_DID!="410472" && job_DID!="411076" && job_DID!="411077" && job_DID!="411078") { continue; }
-	  else { cout << "\n\nDID: " << job_DID << endl; }
-
-
-	  // Testing option: keep only tt+all if true
-	  bool only_410472 = false;
-	  //if (job_DID=="410472") { only_410472=true; } else { continue; }
-
-
-	  // Make a list of paths to ntuples of the given job/DID
-	  vector<TString> paths_to_ntuples = get_list_of_files(paths_to_jobs[job_number]);
-
-
-	  // Loop over ntuples of one job/DID
-	  for (int ntuple_number=0; ntuple_number<paths_to_ntuples.size(); ntuple_number++)
-	    {
-	      // Open ntuple
-	      cout << paths_to_ntuples[ntuple_number] << endl;
-	      TFile *ntuple = new TFile (paths_to_ntuples[ntuple_number]);
-	      TTree *tree_nominal = (TTree*)ntuple->Get("nominal");
-
-
-	      // Set all the needed branches
-	      vector<Float_t> *jet_pt, *jet_DL1r, *jet_eta, *jet_phi, *jet_e;
-	      vector<Float_t> *el_pt, *el_eta, *el_cl_eta, *el_phi, *el_charge, *el_e;
-	      vector<Float_t> *mu_pt, *mu_eta, *mu_phi, *mu_charge, *mu_e;
-	      vector<int> *topHadronOriginFlag, *jet_truthflav;
-	      vector<char> *jet_DL1r_77;
-	      jet_pt = jet_DL1r = jet_eta = jet_phi = jet_e = 0;
-	      el_pt = el_eta = el_cl_eta = el_phi = el_charge = el_e = 0;
-	      mu_pt = mu_eta = mu_phi = mu_charge = mu_e = 0;
-	      topHadronOriginFlag = jet_truthflav = 0;
-	      jet_DL1r_77 = 0;
-	      Float_t met, met_phi;
-	      tree_nominal->SetBranchAddress("jet_pt", &jet_pt);
-              tree_nominal->SetBranchAddress("jet_eta", &jet_eta);
-              tree_nominal->SetBranchAddress("jet_phi", &jet_phi);
-	      tree_nominal->SetBranchAddress("jet_e", &jet_e);
-              tree_nominal->SetBranchAddress("jet_DL1r", &jet_DL1r);
-	      tree_nominal->SetBranchAddress("jet_isbtagged_DL1r_77", &jet_DL1r_77);
-              tree_nominal->SetBranchAddress("jet_truthflav", &jet_truthflav);
-	      tree_nominal->SetBranchAddress("el_pt", &el_pt);
-              tree_nominal->SetBranchAddress("el_eta", &el_eta);
-	      tree_nominal->SetBranchAddress("el_cl_eta", &el_cl_eta);
-              tree_nominal->SetBranchAddress("el_phi", &el_phi);
-              tree_nominal->SetBranchAddress("el_charge", &el_charge);
-	      tree_nominal->SetBranchAddress("el_e", &el_e);
-              tree_nominal->SetBranchAddress("mu_pt", &mu_pt);
-              tree_nominal->SetBranchAddress("mu_eta", &mu_eta);
-              tree_nominal->SetBranchAddress("mu_phi", &mu_phi);
-              tree_nominal->SetBranchAddress("mu_charge", &mu_charge);
-	      tree_nominal->SetBranchAddress("mu_e", &mu_e);
-              tree_nominal->SetBranchAddress("jet_GBHInit_topHadronOriginFlag", &topHadronOriginFlag); // https://gitlab.cern.ch/TTJ/Ntuple/-/blob/master/TTJNtuple/TTJNtuple/EventSaver.h#L55 
-	      tree_nominal->SetBranchAddress("met_met", &met);
-	      tree_nominal->SetBranchAddress("met_phi", &met_phi);
-	      
-
-	      // Weights
-	      float w_mc, w_pu, w_leptonSF, w_DL1r_77, w_jvt;
-              UInt_t runNumber;
-              tree_nominal->SetBranchAddress("weight_mc", &w_mc);
-              tree_nominal->SetBranchAddress("weight_pileup", &w_pu);
-              tree_nominal->SetBranchAddress("weight_leptonSF", &w_leptonSF);
-              tree_nominal->SetBranchAddress("weight_bTagSF_DL1r_77", &w_DL1r_77);
-              tree_nominal->SetBranchAddress("weight_jvt", &w_jvt);
-              tree_nominal->SetBranchAddress("runNumber", &runNumber);
-
-
-	      // Top flavor filter flag
-	      int topHFFF;
-              tree_nominal->SetBranchAddress("topHeavyFlavorFilterFlag", &topHFFF);
-
-
-	      // Ignore the "ReadStreamerInfo, class:string, illegal uid=-2" erro
-
-
-	      // Loop over entries
-	      Int_t nEntries = tree_nominal->GetEntries();
-	      cout << "\tEntries = " << nEntries << endl;
-	      for (int entry=0; entry<nEntries; entry++)
-		{
-		  // Show events counter
-		  if (entry%1000==0) { cout << "\t" << entry << "\r"; cout.flush(); }
-		  tree_nominal->GetEntry(entry);
-		  
-
-		  // Compute weights
-		  double weight_lumi = 1;
-                  double sumWeights = 1;
-                  double campaign_lumi = 1;
-                  double campaign_xsection = 1;
-                  double campaign_genFiltEff = 1;
-                  double kFactor = 1;
-                  double total_lumi = 3.21956 + 32.9881 + 44.3074 + 58.4501;
-		  
-		  if (runNumber==284500) {
-		    campaign_lumi = 3.21956 + 32.9881;
-		    if (job_DID=="411076") {
-		      sumWeights = 3.33006*pow(10, 9);
-		      campaign_xsection = 0.72977;
-		      campaign_genFiltEff = 0.008814;
-		      kFactor = 1.1397; }
-		    if (job_DID=="411077") {
-		      sumWeights = 3.61088*pow(10, 9);
-		      campaign_xsection = 0.72977;
-		      campaign_genFiltEff = 0.046655;
-		      kFactor = 1.1398; }
-		    if (job_DID=="411078") {
-		      sumWeights = 3.61598*pow(10, 9);
-		      campaign_xsection = 0.72977;
-		      campaign_genFiltEff = 0.039503;
-		      kFactor = 1.1397; }
-		    if (job_DID=="410472") {
-		      sumWeights = 5.82869*pow(10, 10);
-		      campaign_xsection = 0.72977;
-		      campaign_genFiltEff = 0.10547;
-		      kFactor = 1.13975636159; } }
-		  if (runNumber==300000) {
-		    campaign_lumi = 44.3074;
-		    if (job_DID=="411076") {
-		      sumWeights = 4.21891*pow(10, 9);
-		      campaign_xsection = 0.72977;
-		      campaign_genFiltEff = 0.008814;
-		      kFactor = 1.1397; }
-		    if (job_DID=="411077") {
-		      sumWeights = 4.49595*pow(10, 9);
-		      campaign_xsection = 0.72977;
-		      campaign_genFiltEff = 0.046655;
-		      kFactor = 1.1398; }
-		    if (job_DID=="411078") {
-		      sumWeights = 4.49400*pow(10, 9);
-		      campaign_xsection = 0.72977;
-		      campaign_genFiltEff = 0.039503;
-		      kFactor = 1.1397; }
-		    if (job_DID=="410472") {
-		      sumWeights = 7.26510*pow(10, 10);
-		      campaign_xsection = 0.72977;
-		      campaign_genFiltEff = 0.10547;
-		      kFactor = 1.13975636159; } }
-		  if (runNumber==310000) {
-		    campaign_lumi = 58.4501;
-		    if (job_DID=="411076") {
-		      sumWeights = 5.47811*pow(10, 9);
-		      campaign_xsection = 0.72977;
-		      campaign_genFiltEff = 0.008814;
-		      kFactor = 1.1397; }
-		    if (job_DID=="411077") {
-		      sumWeights = 5.94763*pow(10, 9);
-		      campaign_xsection = 0.72977;
-		      campaign_genFiltEff = 0.046655;
-		      kFactor = 1.1398; }
-		    if (job_DID=="411078") {
-		      sumWeights = 5.94190*pow(10, 9);
-		      campaign_xsection = 0.72977;
-		      campaign_genFiltEff = 0.039503;
-		      kFactor = 1.1397; }
-		    if (job_DID=="410472") {
-		      sumWeights = 1.01641*pow(10, 11);
-		      campaign_xsection = 0.72977;
-		      campaign_genFiltEff = 0.10547;
-		      kFactor = 1.13975636159; } }
-		  
-		  // Actual computation:
-		  weight_lumi = campaign_lumi * campaign_xsection * pow(10,6) * campaign_genFiltEff * kFactor / sumWeights;
-		  double weights = w_mc * w_pu * w_leptonSF * w_DL1r_77 * w_jvt * weight_lumi;
-
-		  
-		  // Initiate cuts names
-		  bool emu_cut = false;
-                  bool OS_cut = false;
-                  bool jets_n_cut = false;
-		  bool btags_n2_cut = false;
-                  bool bjets_n2_cut = false;
-                  bool bjets_n3_cut = false;
-                  bool topHFFF_cut = false;
-		  
-
-		  // Define cuts themselves
-		  if ((*el_pt).size()==1 && (*mu_pt).size()==1) emu_cut = true;
-		  if ((*el_charge)[0]!=(*mu_charge)[0]) OS_cut = true;
-		  
-		  int bjets_n = 0;
-		  for (int i=0; i<(*jet_pt).size(); i++) { if ( int((*jet_truthflav)[i]==1) ) bjets_n++; }
-		  if (bjets_n==3) bjets_n3_cut = true;
-                  if (bjets_n>=2) bjets_n2_cut = true;
-                  
-		  int jets_n = (*jet_pt).size();
-                  if (jets_n >=3) jets_n_cut = true;
-		  
-		  int btags_n = 0;
-		  for (int i=0; i<(*jet_pt).size(); i++) { if ((*jet_DL1r_77)[i]==1) btags_n++; }
-		  if (btags_n >=2) btags_n2_cut = true;
-                  
-		  if ( only_410472==true || ( (topHFFF==1 && job_DID=="411076") || (topHFFF==2 && job_DID=="411077") || (topHFFF==3 && job_DID=="411078") || (topHFFF==0 && job_DID=="410472") ) ) topHFFF_cut = true;
-
-
-		  
-		  // TLorentzVectors for leptons and jets
-		  TLorentzVector el_lvec;
-		  TLorentzVector mu_lvec;
-		  vector<TLorentzVector> jets_lvec;
-		  el_lvec.SetPtEtaPhiE((*el_pt)[0]*0.001, (*el_eta)[0], (*el_phi)[0], (*el_e)[0]*0.001);
-		  mu_lvec.SetPtEtaPhiE((*mu_pt)[0]*0.001, (*mu_eta)[0], (*mu_phi)[0], (*mu_e)[0]*0.001);
-		  for (int jet_i=0; jet_i<(*jet_pt).size(); jet_i++) {
-		    TLorentzVector lvec;
-		    lvec.SetPtEtaPhiE((*jet_pt)[jet_i]*0.001, (*jet_eta)[jet_i], (*jet_phi)[jet_i], (*jet_e)[jet_i]*0.001);
-		    jets_lvec.push_back(lvec); }
-
-
-		  
-		  // 3b, emu, OS channel: Draw min_dR
-		  if (emu_cut*OS_cut*bjets_n3_cut*topHFFF_cut*jets_n_cut == true)
-		    {
-		      
-		      // Define min_dR as some lagre value to begin with
-                      double min_dR1_top = 999999.; // leading lepton
-                      double min_dR2_top = 999999.; // subleading lepton
-                      double min_dR1_not_top = 999999.; // leading lepton
-                      double min_dR2_not_top = 999999.; // subleading lepton
-		      
-		      
-		      // Loop over all jets, and select only b-tagged in the loop
-		      for (int jet_i=0; jet_i<(*jet_pt).size(); jet_i++) {
-			if ( (*jet_truthflav)[jet_i]==5) {
-			      
-			    // Define initial dR's
-			    double dR1 = 0;
-			    double dR2 = 0;
-			    
-			    // Assign dR1 to the leading lep and dR2 to the subleading 
-			    if ((*mu_pt)[0]>(*el_pt)[0]) {
-			      dR1 = mu_lvec.DeltaR(jets_lvec[jet_i]);
-			      dR2 = el_lvec.DeltaR(jets_lvec[jet_i]); }
-			    else {
-			      dR1 = mu_lvec.DeltaR(jets_lvec[jet_i]);
-			      dR2 = mu_lvec.DeltaR(jets_lvec[jet_i]); }
-			    
-			    // Sort wrt origin
-			    if ((*topHadronOriginFlag)[jet_i]==4) { 
-			      min_dR1_top = min(min_dR1_top, dR1); min_dR2_top = min(min_dR2_top, dR2); }
-			    else {
-			      min_dR1_not_top = min(min_dR1_not_top, dR1); min_dR2_not_top = min(min_dR2_not_top, dR2); }
-			  
-			  }  // selection of b-jets from all jets
-			
-		      } // [jet_i] - loop over jets
-		      
-		      
-		      // Fill min_dR histograms
-		      h_minDeltaR_lep0_bjets_from_top->Fill(min_dR1_top, weights);
-		      h_minDeltaR_lep0_bjets_not_from_top->Fill(min_dR1_not_top, weights);
-		      h_minDeltaR_lep1_bjets_from_top->Fill(min_dR2_top, weights);
-		      h_minDeltaR_lep1_bjets_not_from_top->Fill(min_dR2_not_top, weights);
-		      
-		    } // 3b, emu, OS cuts
-		  
-		  
-
-		  // 2+b (tags), emu, OS
-		  if (emu_cut*OS_cut*btags_n2_cut*topHFFF_cut*jets_n_cut == true) {
-		    
-		    // MET hists:
-		    h_met->Fill(met*0.001, weights);
-		    h_met_phi->Fill(met_phi, weights);
-		    
-		    
-		    // jet pt hists:
-		    for (int i=0; i<3; i++) { h_jet_pt[i]->Fill((*jet_pt)[i]*0.001, weights); }
-		    
-
-		    // btags_n hist:
-		    int btags_n = 0;
-		    for (int jet_i=0; jet_i<(*jet_pt).size(); jet_i++) { btags_n ++; }
-		    h_bjets_n->Fill(btags_n, weights);
-		    
-
-		    // leptons hists:
-		    if ( (*el_pt)[0] > (*mu_pt)[0] ) {
-		      h_lep0_pt->Fill((*el_pt)[0]*0.001, weights);
-		      h_lep1_pt->Fill((*mu_pt)[0]*0.001, weights);
-		      h_lep0_eta->Fill((*el_eta)[0], weights);
-		      h_lep1_eta->Fill((*mu_eta)[0], weights);
-		      h_lep0_phi->Fill((*el_phi)[0], weights);
-		      h_lep1_phi->Fill((*mu_phi)[0], weights); }
-		    else {
-		      h_lep0_pt->Fill((*mu_pt)[0]*0.001, weights);
-		      h_lep1_pt->Fill((*el_pt)[0]*0.001, weights);
-		      h_lep0_eta->Fill((*mu_eta)[0], weights);
-		      h_lep1_eta->Fill((*el_eta)[0], weights);
-		      h_lep0_phi->Fill((*mu_phi)[0], weights);
-		      h_lep1_phi->Fill((*el_phi)[0], weights); }
-		    h_lep_pt->Fill((*el_pt)[0]*0.001, weights);
-		    h_lep_pt->Fill((*mu_pt)[0]*0.001, weights);
-		    h_lep_eta->Fill((*el_eta)[0], weights);
-		    h_lep_eta->Fill((*mu_eta)[0], weights);
-		    h_lep_phi->Fill((*el_phi)[0], weights);
-		    h_lep_phi->Fill((*mu_phi)[0], weights);
-		  
-		    
-		    // dR(lep0, lep1) hist:
-		    h_dR_lep0_lep1->Fill(el_lvec.DeltaR(mu_lvec));
-		    
-		    
-		    // dR_min lep0/1 btags
-		    double min_dR1_top = 999999.; // leading lepton
-		    double min_dR2_top = 999999.; // subleading lepton
-		    double min_dR1_not_top = 999999.; // leading lepton
-		    double min_dR2_not_top = 999999.; // subleading lepton
-		    
-		    for (int jet_i=0; jet_i<(*jet_pt).size(); jet_i++) {
-		      if ((*jet_DL1r_77)[jet_i]==1) {
-
-			double dR1 = 0;
-			double dR2 = 0;
-
-			if ((*mu_pt)[0]>(*el_pt)[0]) {
-			  dR1 = mu_lvec.DeltaR(jets_lvec[jet_i]);
-			  dR2 = el_lvec.DeltaR(jets_lvec[jet_i]); }
-			else {
-			  dR1 = mu_lvec.DeltaR(jets_lvec[jet_i]);
-			  dR2 = mu_lvec.DeltaR(jets_lvec[jet_i]); }
-		      
-			if ((*topHadronOriginFlag)[jet_i]==4) {
-			  min_dR1_top = min(min_dR1_top, dR1); 
-			  min_dR2_top = min(min_dR2_top, dR2);}
-			else {
-			  min_dR1_not_top = min(min_dR1_not_top, dR1); 
-			  min_dR2_not_top = min(min_dR2_not_top, dR2); }
-			
-		      } // [if] DL1r tag 
-		    } // [jet_i] - loop over jets
-		    
-		    h_minDeltaR_lep0_btags_from_top->Fill(min_dR1_top, weights);
-		    h_minDeltaR_lep0_btags_not_from_top->Fill(min_dR1_not_top, weights);
-		    h_minDeltaR_lep1_btags_from_top->Fill(min_dR2_top, weights);
-		    h_minDeltaR_lep1_btags_not_from_top->Fill(min_dR2_not_top, weights);
-		    
-		  } // 2+b (tags) selection
-
-		  
-		  
-		  // 2+b (jets), emu, OS channel
-		  if (emu_cut*OS_cut*bjets_n2_cut*topHFFF_cut*jets_n_cut == true) {
-		      
-		      // Compute min dR for different jet-obj combinations
-		      double min_dR_b_from_top_to_b = 999999.;
-		      double min_dR_b_not_from_top_to_b = 999999.;
-		      double min_dR_not_b_to_b = 999999.;
-		      double min_dR_b_from_top_to_jet = 999999.;
-		      double min_dR_b_not_from_top_to_jet = 999999.;
-		      double min_dR_not_b_to_jet = 999999.;
-		      double min_dR_b_from_top_to_lep = 999999.;
-		      double min_dR_b_not_from_top_to_lep = 999999.;
-		      double min_dR_not_b_to_lep = 999999.;
-		      
-		      for (int i=0; i<(*jet_pt).size(); i++) {
-			
-			for (int j=0; j<(*jet_pt).size(); j++) {
-			  if (i==j) continue;
-			  
-			  // dR_min 
-			  if ((*jet_truthflav)[i]==5 && (*topHadronOriginFlag)[i]==4 && (*jet_truthflav)[j]==5) {
-			    double dR_b_from_top_to_b = jets_lvec[i].DeltaR(jets_lvec[j]);
-			    if (dR_b_from_top_to_b < min_dR_b_from_top_to_b) min_dR_b_from_top_to_b = dR_b_from_top_to_b; }
-			  
-			  if ((*jet_truthflav)[i]==5 && (*topHadronOriginFlag)[i]!=4 && (*jet_truthflav)[j]==5) {
-			    double dR_b_not_from_top_to_b = jets_lvec[i].DeltaR(jets_lvec[j]);
-			    if (dR_b_not_from_top_to_b < min_dR_b_not_from_top_to_b) min_dR_b_not_from_top_to_b = dR_b_not_from_top_to_b; }
-			  
-			  if ((*jet_truthflav)[i]!=5 && (*topHadronOriginFlag)[i]!=4 && (*jet_truthflav)[j]==5) {
-			    double dR_not_b_to_b = jets_lvec[i].DeltaR(jets_lvec[j]);
-			    if (dR_not_b_to_b < min_dR_not_b_to_b) min_dR_not_b_to_b = dR_not_b_to_b; }
-			  
-			  if ((*jet_truthflav)[i]==5 && (*topHadronOriginFlag)[i]==4 && (*jet_truthflav)[j]!=5) {
-			    double dR_b_from_top_to_jet = jets_lvec[i].DeltaR(jets_lvec[j]);
-			    if (dR_b_from_top_to_jet < min_dR_b_from_top_to_jet) min_dR_b_from_top_to_jet = dR_b_from_top_to_jet; }
-			  
-			  if ((*jet_truthflav)[i]==5 && (*topHadronOriginFlag)[i]!=4 && (*jet_truthflav)[j]!=5) {
-			    double dR_b_not_from_top_to_jet = jets_lvec[i].DeltaR(jets_lvec[j]);
-			    if (dR_b_not_from_top_to_jet < min_dR_b_not_from_top_to_jet) min_dR_b_not_from_top_to_jet = dR_b_not_from_top_to_jet; }
-			  
-			  if ((*jet_truthflav)[i]!=5 && (*topHadronOriginFlag)[i]!=4 && (*jet_truthflav)[j]!=5) {
-			    double dR_not_b_to_jet = jets_lvec[i].DeltaR(jets_lvec[j]);
-			    if (dR_not_b_to_jet < min_dR_not_b_to_jet) min_dR_not_b_to_jet = dR_not_b_to_jet; }
-			} // loop over jet[j]
-			
-			if ((*jet_truthflav)[i]==5 && (*topHadronOriginFlag)[i]==4) {
-			  double dR_b_from_top_to_el = jets_lvec[i].DeltaR(el_lvec);
-			  double dR_b_from_top_to_mu = jets_lvec[i].DeltaR(mu_lvec);
-			  double dR_b_from_top_to_lep = min(dR_b_from_top_to_el, dR_b_from_top_to_mu);
-			  if (dR_b_from_top_to_lep < min_dR_b_from_top_to_lep) min_dR_b_from_top_to_lep = dR_b_from_top_to_lep; }
-			
-			if ((*jet_truthflav)[i]==5 && (*topHadronOriginFlag)[i]!=4) {
-			  double dR_b_not_from_top_to_el = jets_lvec[i].DeltaR(el_lvec);
-			  double dR_b_not_from_top_to_mu = jets_lvec[i].DeltaR(mu_lvec);
-			  double dR_b_not_from_top_to_lep = min(dR_b_not_from_top_to_el, dR_b_not_from_top_to_mu);
-			  if (dR_b_not_from_top_to_lep < min_dR_b_not_from_top_to_lep) min_dR_b_not_from_top_to_lep = dR_b_not_from_top_to_lep; }
-			
-			if ((*jet_truthflav)[i]!=5 && (*topHadronOriginFlag)[i]!=4) {
-			  double dR_not_b_to_el = jets_lvec[i].DeltaR(el_lvec);
-			  double dR_not_b_to_mu = jets_lvec[i].DeltaR(mu_lvec);;
-			  double dR_not_b_to_lep = min(dR_not_b_to_el, dR_not_b_to_mu);
-			  if (dR_not_b_to_lep < min_dR_not_b_to_lep) min_dR_not_b_to_lep = dR_not_b_to_lep; }
-			
-		      } // loop over jet[i]
-		      
-		      h_minDeltaR_b_from_top_to_b->Fill(min_dR_b_from_top_to_b, weights);
-		      h_minDeltaR_b_not_from_top_to_b->Fill(min_dR_b_not_from_top_to_b, weights);
-		      h_minDeltaR_not_b_to_b->Fill(min_dR_not_b_to_b, weights);
-		      h_minDeltaR_b_from_top_to_jet->Fill(min_dR_b_from_top_to_jet, weights);
-		      h_minDeltaR_b_not_from_top_to_jet->Fill(min_dR_b_not_from_top_to_jet, weights);
-		      h_minDeltaR_not_b_to_jet->Fill(min_dR_not_b_to_jet, weights);
-		      h_minDeltaR_b_from_top_to_lep->Fill(min_dR_b_from_top_to_lep, weights);
-		      h_minDeltaR_b_not_from_top_to_lep->Fill(min_dR_b_not_from_top_to_lep, weights);
-		      h_minDeltaR_not_b_to_lep->Fill(min_dR_not_b_to_lep, weights);
-
-
-		      // KLFitter invariant mass calculations:
-		      //KLFitter::Particles particles{};
-                      //likelihood.SetLeptonType(KLFitter::LikelihoodTopDilepton::kElectron, KLFitter::LikelihoodTopDilepton::kMuon);
-		      // Add leptons
-                      //particles.AddParticle(el_lvec, (*el_cl_eta)[0], (*el_charge)[0], KLFitter::Particles::kElectron);
-		      //particles.AddParticle(mu_lvec, mu_lvec.Eta(), (*mu_charge)[0], KLFitter::Particles::kMuon);
-                      // Add two leading pT jets
-		      //for (int jet_i=0; jet_i<3; jet_i++) { particles.AddParticle(jet_lvec, jet_lvec.Eta(), KLFitter::Particles::kParton, "", jet_i); }
-		      //fitter.SetParticles(&particles);
-		      // Add MET
-		      //fitter.SetET_miss_XY_SumET(met*0.001*cos(met_phi), met*0.001*sin(met_phi), met*0.001);
-
-		      
-		      // Loop over permutations
-		      //int n_perm = fitter.Permutations()->NPermutations();
-		      //for (int perm_i=0; perm_i < n_perm; perm_i++) {
-		      //fitter.Fit(perm_i);
-		      //auto permutedParticles = fitter.Likelihood()->PParticlesPermuted();
-		      //double llh = fitter.Likelihood()->LogLikelihood(fitter.Likelihood()->GetBestFitParameters()); }
-		      
-		      
-
-		      // Invariant mass of bjet-lepton pairs		      
-		      double min_inv_mass_lep_bjet_from_top = 999999;
-		      double max_inv_mass_lep_bjet_from_top = 0;
-		      double min_inv_mass_lep_bjet_not_from_top = 999999;
-		      double max_inv_mass_lep_bjet_not_from_top = 0;
-		      double min_inv_mass_lep_other_jet = 999999;
-		      double max_inv_mass_lep_other_jet = 0;
-		      
-		      for (int jet_i=0; jet_i<jet_pt->size(); jet_i++) {
-			
-			// bjets and the closest leptons
-			if ((*jet_truthflav)[jet_i]==5) {
-			  if ((*topHadronOriginFlag)[jet_i]==4) {
-			    double dr_j_el = jets_lvec[jet_i].DeltaR(el_lvec);
-			    double dr_j_mu = jets_lvec[jet_i].DeltaR(mu_lvec);
-			    double inv_mass_j_lep = 0;
-			    if (dr_j_el <= dr_j_mu) { inv_mass_j_lep = (jets_lvec[jet_i] + el_lvec).M(); }
-			    else { inv_mass_j_lep = (jets_lvec[jet_i] + mu_lvec).M(); }
-			    if (inv_mass_j_lep != 0) h_inv_mass_lep_bjet_from_top_min_dR->Fill(inv_mass_j_lep, weights); }
-			  else { 
-			    double dr_j_el = jets_lvec[jet_i].DeltaR(el_lvec);
-			    double dr_j_mu = jets_lvec[jet_i].DeltaR(mu_lvec);
-			    double inv_mass_j_lep = 0;
-			    if (dr_j_el <= dr_j_mu) { inv_mass_j_lep = (jets_lvec[jet_i] + el_lvec).M(); }
-			    else { inv_mass_j_lep = (jets_lvec[jet_i] + mu_lvec).M(); }
-			    if (inv_mass_j_lep != 0) h_inv_mass_lep_bjet_not_from_top_min_dR->Fill(inv_mass_j_lep, weights); } }
-			
-			// bjets and leptons - min and max invarinat masses
-			if ((*jet_truthflav)[jet_i]==5) {
-			  if ((*topHadronOriginFlag)[jet_i]==4) {
-			    double min_inv_mass_lep_bjet_from_top_tmp = min( (jets_lvec[jet_i] + el_lvec).M(), (jets_lvec[jet_i] + mu_lvec).M() );
-			    double max_inv_mass_lep_bjet_from_top_tmp = max( (jets_lvec[jet_i] + mu_lvec).M(), (jets_lvec[jet_i] + mu_lvec).M() );
-			    min_inv_mass_lep_bjet_from_top = min(min_inv_mass_lep_bjet_from_top_tmp, min_inv_mass_lep_bjet_from_top);
-			    max_inv_mass_lep_bjet_from_top = max(max_inv_mass_lep_bjet_from_top_tmp, max_inv_mass_lep_bjet_from_top_tmp); }
-			  else {
-			    double min_inv_mass_lep_bjet_not_from_top_tmp = min( (jets_lvec[jet_i] + el_lvec).M(), (jets_lvec[jet_i] + mu_lvec).M() );
-			    double max_inv_mass_lep_bjet_not_from_top_tmp = max( (jets_lvec[jet_i] + el_lvec).M(), (jets_lvec[jet_i] + mu_lvec).M() );
-			    min_inv_mass_lep_bjet_not_from_top = min(min_inv_mass_lep_bjet_not_from_top_tmp, min_inv_mass_lep_bjet_not_from_top);
-			    max_inv_mass_lep_bjet_not_from_top = max(max_inv_mass_lep_bjet_not_from_top_tmp, max_inv_mass_lep_bjet_not_from_top); } }
-			// other than bjets and leptons - min and max invariant masses
-			else {
-			  double min_inv_mass_lep_other_jet_tmp = min( (jets_lvec[jet_i] + el_lvec).M(), (jets_lvec[jet_i] + mu_lvec).M() );
-			  double max_inv_mass_lep_other_jet_tmp = max( (jets_lvec[jet_i] + el_lvec).M(), (jets_lvec[jet_i] + mu_lvec).M() );
-			  min_inv_mass_lep_other_jet = min( (jets_lvec[jet_i] + el_lvec).M(), (jets_lvec[jet_i] + mu_lvec).M() );
-			  max_inv_mass_lep_other_jet = max( (jets_lvec[jet_i] + el_lvec).M(), (jets_lvec[jet_i] + mu_lvec).M() ); }
-		      }
-		      
-		      // Fill the min/max invariant mass hists
-		      if (min_inv_mass_lep_bjet_from_top!=999999) h_min_inv_mass_lep_bjet_from_top->Fill(min_inv_mass_lep_bjet_from_top, weights);
-		      if (max_inv_mass_lep_bjet_from_top!=0) h_max_inv_mass_lep_bjet_from_top->Fill(max_inv_mass_lep_bjet_from_top, weights);
-		      if (min_inv_mass_lep_bjet_not_from_top!=999999) h_min_inv_mass_lep_bjet_not_from_top->Fill(min_inv_mass_lep_bjet_not_from_top, weights);
-		      if (max_inv_mass_lep_bjet_not_from_top!=0) h_max_inv_mass_lep_bjet_not_from_top->Fill(max_inv_mass_lep_bjet_not_from_top, weights);
-		      if (min_inv_mass_lep_other_jet!=999999) h_min_inv_mass_lep_other_jet->Fill(min_inv_mass_lep_other_jet, weights);
-		      if (max_inv_mass_lep_other_jet!=0) h_max_inv_mass_lep_other_jet->Fill(max_inv_mass_lep_other_jet, weights);
-
-
-		      // Fill the NN vector variables
-		      NN_tHOF_v.push_back((*topHadronOriginFlag));
-		      NN_jet_truthflav_v.push_back((*jet_truthflav));	
-		      
-		      
-
-		      // Sort jets wrt DL1r tag weights
-		      sort (jet_DL1r->begin(), jet_DL1r->end(), greater<int>());
-
-
-		      // Fill DL1r tag weight histos for the first three tags, also sort wrt topHFFF
-		      h_tag0_DL1r[topHFFF]->Fill((*jet_DL1r)[0], weights);
-                      h_tag1_DL1r[topHFFF]->Fill((*jet_DL1r)[1], weights);
-                      h_tag2_DL1r[topHFFF]->Fill((*jet_DL1r)[2], weights);
-
-		    } // 2+b, emu, OS cuts 
-
-		} // [entry] - loop over entries
-	      
-	      // Close ntuple after we're done with it
-	      ntuple->Close();
-	      
-	    } // [ntuple_number] - loop over ntuples of a particular job
-	  
-	} // [job_number] - loop over jobs (pieces) of a collection.
-
-    } // [dir_counter] - loop over directories names with jobs folders: mc16a, mc16d, mc16e, data
-
-
-
-
-  // Save histograms
-
-  TFile *hists_file = new TFile("hists_mc.root", "RECREATE");
-
-  // dR_min between bjets and leptons, 3b channel  
-  h_minDeltaR_lep0_bjets_from_top->Write("3b_emu_OS_min_dR_lep0_b_from_top");
-  h_minDeltaR_lep1_bjets_from_top->Write("3b_emu_OS_min_dR_lep1_b_from_top");
-  h_minDeltaR_lep0_bjets_not_from_top->Write("3b_emu_OS_min_dR_lep0_b_not_from_top");
-  h_minDeltaR_lep1_bjets_not_from_top->Write("3b_emu_OS_min_dR_lep1_b_not_from_top");
+      // Entries outside all the regions in an earlier run are not read at all
+      if (masks.from_earlier_run() && (masks.has_all(entry, mc_preselection_bits)==false || masks.has_any(entry, b_bits)==false)) continue;
 
-  // dR_min between btags and leptons, 2b channel
-  h_minDeltaR_lep0_btags_from_top->Write("2b_emu_OS_min_dR_lep0_b_from_top");
-  h_minDeltaR_lep1_btags_from_top->Write("2b_emu_OS_min_dR_lep1_b_from_top");
-  h_minDeltaR_lep0_btags_not_from_top->Write("2b_emu_OS_min_dR_lep0_b_not_from_top");
-  h_minDeltaR_lep1_btags_not_from_top->Write("2b_emu_OS_min_dR_lep1_b_not_from_top");
+      // Heavy branches are loaded only for events passing the cheap cuts
+      branches.load_first(entry);
+      UInt_t preselection_mask = get_preselection_mask(ev, range);
+      if ((preselection_mask & mc_preselection_bits) != mc_preselection_bits) {
+        masks.set(entry, preselection_mask);
+        branches.skip_rest();
+        continue; }
+      branches.load_rest(entry);
 
-  // dR_min, 2b channel
-  h_minDeltaR_b_from_top_to_b->Write("2b_emu_OS_h_minDeltaR_b_from_top_to_b");
-  h_minDeltaR_b_not_from_top_to_b->Write("2b_emu_OS_h_minDeltaR_b_not_from_top_to_b");
-  h_minDeltaR_not_b_to_b->Write("2b_emu_OS_h_minDeltaR_not_b_to_b");
-  h_minDeltaR_b_from_top_to_jet->Write("2b_emu_OS_h_minDeltaR_b_from_top_to_jet");
-  h_minDeltaR_b_not_from_top_to_jet->Write("2b_emu_OS_h_minDeltaR_b_not_from_top_to_jet");
-  h_minDeltaR_not_b_to_jet->Write("2b_emu_OS_h_minDeltaR_not_b_to_jet");
-  h_minDeltaR_b_from_top_to_lep->Write("2b_emu_OS_h_minDeltaR_b_from_top_to_lep");
-  h_minDeltaR_b_not_from_top_to_lep->Write("2b_emu_OS_h_minDeltaR_b_not_from_top_to_lep");
-  h_minDeltaR_not_b_to_lep->Write("2b_emu_OS_h_minDeltaR_not_b_to_lep");
-
-  // pT of the three leading jets, 2b channel 
-  for (int i=0; i<3; i++) { 
-    TString title = "2b_emu_OS_pt_jet_" + to_string(i);
-    h_jet_pt[i]->Write(title); }
-  
 
-  // the first three DL1r tag distributions for 2b1l / 4b / 3b / 2b1c, 2b channel
-  for (int topHFFF_i=0; topHFFF_i<4; topHFFF_i++) {
-    TString process = "";
-    if (topHFFF_i==0) process = "2b1l";
-    if (topHFFF_i==1) process = "4b";
-    if (topHFFF_i==2) process = "3b";
-    if (topHFFF_i==3) process = "2b1c";
-    h_tag0_DL1r[topHFFF_i]->Write("DL1r_templates_"+process+"_1st_tag");
-    h_tag1_DL1r[topHFFF_i]->Write("DL1r_templates_"+process+"_2nd_tag");
-    h_tag2_DL1r[topHFFF_i]->Write("DL1r_templates_"+process+"_3rd_tag"); }
+      // Compute weights, skims carry them already folded in; every weight
+      // variation replaces one factor of the nominal product
+      weights[0] = 1;
+      if (!is_data) weights[0] = range.from_skim ? ev.weight_norm : ev.weight_product() * range.norm_factor;
+      for (int var_i=0; var_i<weight_variations.size(); var_i++) {
+        weights[1 + var_i] = ev.weight_product(weight_variations[var_i].factor, weight_variations[var_i].get()) * range.norm_factor; }
 
-  // MET, 2b channel
-  h_met->Write("2b_emu_OS_met");
-  h_met_phi->Write("2b_emu_OS_met_phi");
-  
-  // bjets_n, 2b channel
-  h_bjets_n->Write("2b_emu_OS_bjets_n");
-  
-  // leptons, 2b channel 
-  h_lep0_pt->Write("2b_emu_OS_lep0_pt");
-  h_lep1_pt->Write("2b_emu_OS_lep1_pt");
-  h_lep_pt->Write("2b_emu_OS_lep_pt");
-  h_lep0_eta->Write("2b_emu_OS_lep0_eta");
-  h_lep1_eta->Write("2b_emu_OS_lep1_eta");
-  h_lep_eta->Write("2b_emu_OS_lep_eta");
-  h_lep0_phi->Write("2b_emu_OS_lep0_phi");
-  h_lep1_phi->Write("2b_emu_OS_lep1_phi");
-  h_lep_phi->Write("2b_emu_OS_lep_phi");
-  h_dR_lep0_lep1->Write("2b_emu_OS_dR_lep0_lep1");
-  
-  // Invariant mass
-  h_inv_mass_lep_bjet_from_top_min_dR->Write("2b_emu_OS_h_inv_mass_lep_bjet_from_top_min_dR");
-  h_inv_mass_lep_bjet_not_from_top_min_dR->Write("2b_emu_OS_h_inv_mass_lep_bjet_not_from_top_min_dR");
-  h_inv_mass_lep_btag_from_top_min_dR->Write("2b_emu_OS_h_inv_mass_lep_btag_from_top_min_dR");
-  h_inv_mass_lep_btag_not_from_top_min_dR->Write("2b_emu_OS_h_inv_mass_lep_btag_not_from_top_min_dR");
-  h_min_inv_mass_lep_bjet_from_top->Write("2b_emu_OS_h_min_inv_mass_lep_bjet_from_top");
-  h_max_inv_mass_lep_bjet_from_top->Write("2b_emu_OS_h_max_inv_mass_lep_bjet_from_top");
-  h_min_inv_mass_lep_bjet_not_from_top->Write("2b_emu_OS_h_min_inv_mass_lep_bjet_not_from_top");
-  h_max_inv_mass_lep_bjet_not_from_top->Write("2b_emu_OS_h_max_inv_mass_lep_bjet_not_from_top");
-  h_min_inv_mass_lep_other_jet->Write("2b_emu_OS_h_min_inv_mass_lep_other_jet");
-  h_max_inv_mass_lep_other_jet->Write("2b_emu_OS_h_max_inv_mass_lep_other_jet");
-
-  // Close the hists file
-  hists_file->Close();
-
-
-  // Fill NN ROOT file
-  TFile *NN_tfile= new TFile("tt_jets_NN_input.root", "RECREATE");
-  TTree *NN_ttree = new TTree("nominal", "NN_input");
-  vector<int> *NN_tHOF, *NN_jet_truthflav;
-  TBranch *NN_topHadronOriginFlag_br = NN_ttree->Branch("topHadronOriginFlag", &NN_tHOF, "topHadronOriginFlag/I");
-  TBranch *NN_jet_truthflav_br = NN_ttree->Branch("jet_truthflav", &NN_jet_truthflav, "jet_truthflav/I");
-  for (int entry=0; entry<NN_tHOF_v.size(); entry++) {
-    NN_tHOF = &NN_tHOF_v[entry];
-    NN_jet_truthflav = &NN_jet_truthflav_v[entry];
-    
-    NN_topHadronOriginFlag_br->Fill();
-    NN_jet_truthflav_br->Fill();
-    NN_ttree->Fill();
-  }
-  NN_ttree->Write("nominal", TTree::kOverwrite);
-  NN_tfile->Close();
+
+      // Cuts
+      UInt_t mask = get_selection_mask(get_mc_cuts<is_data>(ev, range));
+      masks.set(entry, mask);
+      if (bank.selects(mask)==false) continue;
+
+
+      // Kinematics of leptons and jets, all the pairs computed once
+      kin.fill(*ev.jet_pt, *ev.jet_eta, *ev.jet_phi, *ev.jet_e,
+               (*ev.el_pt)[0], (*ev.el_eta)[0], (*ev.el_phi)[0], (*ev.el_e)[0],
+               (*ev.mu_pt)[0], (*ev.mu_eta)[0], (*ev.mu_phi)[0], (*ev.mu_e)[0]);
+
+
+      // Observables of the regions passed by the event, offered to their histograms
+      obs.compute<is_data>(mask, ev, kin);
+      bank.fill(mask, obs, weights, variation);
+
+
+      // 2+b (jets), emu, OS channel
+      if (!is_data && nominal && (mask & region_2b_emu_OS) == region_2b_emu_OS) {
+
+        // Stream the NN input variables
+        if (NN_writer) NN_writer->fill(ev, weights[0]);
+
+
+        // Dilepton reconstruction, when enabled. KLFitter: events fitted in an
+        // earlier run with the same inputs and configuration are not refitted
+        chrono::steady_clock::time_point reco_start = chrono::steady_clock::now();
+        if (klf) {
+          ULong64_t klf_input_hash = klf->input_hash(ev);
+          klf_result result;
+          if (klf_results->lookup(ev.runNumber, ev.eventNumber, klf_input_hash, result)==false) {
+            result = klf->fit(ev, kin);
+            klf_results->store(ev.runNumber, ev.eventNumber, klf_input_hash, result); }
+          reco_out->fill(ev, weights[0], result); }
+        else if (mlb) reco_out->fill(ev, weights[0], mlb->fit(ev, kin));
+        if (reco_out) reco_out->report.seconds += chrono::duration<double>(chrono::steady_clock::now() - reco_start).count();
+
+      } // 2+b, emu, OS cuts
+
+    } // [entry] - loop over entries of the range
+
+  // Keep the cut results and the fits for the next runs
+  masks.write();
+  if (klf_results) {
+    klf_results->write();
+    lock_guard<mutex> lock(cout_mutex);
+    cout << range.path << "\t[" << range.first << ", " << range.last << "): KLFitter "
+         << klf_results->hits() << " cached, " << klf_results->missed() << " fitted" << endl; }
+
+
+  // Report the bytes read per event
+  Long64_t bytes_read = branches.bytes_read();
+  bytes_skipped += branches.bytes_skipped();
+  { lock_guard<mutex> lock(cout_mutex);
+    cout << range.path << "\t[" << range.first << ", " << range.last << "): "
+         << bytes_read/1024./max(range.last-range.first, Long64_t(1)) << " kB/event read, "
+         << "~" << branches.bytes_skipped()/1024./1024. << " MB (estimate) not deserialised" << endl; }
+
+
+  // Close ntuple after we're done with it
+  ntuple->Close();
+  delete ntuple;
+
+  return bytes_read;
+}
+
+
+
+// ##############
+// ##   MAIN   ##
+// ##############
+// samples: "mc", "data" or both ("mc,data"), processed by the same pool of
+// workers in one pass and written to hists_mc.root and hists_data.root.
+// shard_dir: histograms of every ntuple kept between runs (hist_shards.h),
+// "" for a temporary directory removed at the end, reusing nothing.
+// resume: continue an interrupted run from the ranges it completed (needs
+// the shards). Returns 0 once the outputs are written, 1 on errors.
+// prescreen_*: cuts of the KLFitter pre-screening (klf_prescreen in
+// klfitter_reco.h), used with klfitter_prescreen
+int prepare_hists_mc(int n_threads = 0, Long64_t entries_per_range = 200000, TString skim_path = "", TString systematics_path = "systematics.txt", TString reco = "", bool klfitter_prescreen = false,
+                      TString samples = "mc,data", TString shard_dir = "hist_shards/", bool resume = false,
+                      double prescreen_keep_fraction = 0.5, double prescreen_mlb_max = 160, double prescreen_dR_lep_b_max = 2.5, int prescreen_DL1r_rank_max = 0)
+{
+  // Run over all the cores by default; n_threads=1 is the serial run
+  if (n_threads <= 0) n_threads = thread::hardware_concurrency();
+  if (n_threads <= 0) n_threads = 1;
+  ROOT::EnableThreadSafety();
+  TH1::AddDirectory(kFALSE);
+  bool with_mc = samples.Contains("mc");
+  bool with_data = samples.Contains("data");
+  if (resume && shard_dir=="") { cout << "Resuming needs the histogram shards, give a shard_dir" << endl; return 1; }
+  cout << "Running with " << n_threads << " worker threads" << endl;
+
+
+  // Systematic variations filled in the same pass as the nominal; the skim
+  // only keeps the nominal weights and tree
+  systematics_config systematics;
+  if (skim_path=="" && systematics_path!="") systematics.read(systematics_path);
+  vector<TString> tree_names = {"nominal"};
+  tree_names.insert(tree_names.end(), systematics.trees.begin(), systematics.trees.end());
+
+
+  // Flatten all the ntuples (or the skim written by skim_mc.c) and the data
+  // ntuples into ranges of entries of every tree, the workers then process
+  // them largest first, idle workers stealing the rest
+  TString path_to_ntuples = "/eos/user/e/eantipov/Files/tt_hf/";
+  TString path_to_data = "/eos/atlas/atlascerngroupdisk/phys-top/ttjets/v4/data/";
+  vector<mc_range> ranges;
+  if (with_mc && skim_path=="") ranges = get_list_of_ranges(path_to_ntuples, entries_per_range, "sample_metadata.txt", tree_names);
+  else if (with_mc) ranges = get_list_of_skim_ranges(skim_path, entries_per_range);
+  if (with_data) {
+    vector<mc_range> data_ranges = get_list_of_data_ranges(path_to_data, entries_per_range);
+    ranges.insert(ranges.end(), data_ranges.begin(), data_ranges.end()); }
+  for (int range_i=0; range_i<ranges.size(); range_i++) { ranges[range_i].index = range_i; }
+
+
+  // Optional dilepton reconstruction stage, "klfitter" or the fast "mlb"
+  // pairing, run on the mc nominal events
+  if (reco!="" && reco!="klfitter" && reco!="mlb") { cout << "Unknown reconstruction " << reco << ", use klfitter or mlb" << endl; return 1; }
+#ifdef TTHF_NO_KLFITTER
+  if (reco=="klfitter") { cout << "Built without KLFitter, use mlb or build with KLFitter" << endl; return 1; }
+#endif
+  if (with_mc==false) reco = "";
+  klf_prescreen prescreen;
+  prescreen.enabled = klfitter_prescreen;
+  prescreen.keep_fraction = prescreen_keep_fraction;
+  prescreen.mlb_max = prescreen_mlb_max;
+  prescreen.dR_lep_b_max = prescreen_dR_lep_b_max;
+  prescreen.DL1r_rank_max = prescreen_DL1r_rank_max;
+  if (klfitter_prescreen && (prescreen_keep_fraction <= 0 || prescreen_keep_fraction > 1)) { cout << "The pre-screening keep fraction has to be in (0, 1]" << endl; return 1; }
+
+
+  // Hashes of the sources next to this macro: the cut code keys the
+  // selection masks, all the event processing the histogram shards, with
+  // the systematics and the streamed trees (NN input, reconstruction) for mc
+  TString source_dir = gSystem->GetDirName(__FILE__);
+  TString cut_key, code_key, mc_key;
+  vector<TString> sources = {"prepare_hists_mc.c", "mc_inputs.h", "input_catalog.h", "event_kinematics.h", "selection_masks.h", "branch_manifest.h",
+                             "hist_registry.h", "hist_shards.h", "work_scheduler.h", "code_key.h", "reco_results.h"};
+  vector<TString> mc_sources = {"systematics.h", "nn_writer.h"};
+  vector<TString> mc_config = systematics.definitions();
+  mc_config.push_back("reco " + reco);
+  if (reco!="") {
+    mc_sources.push_back("klfitter_reco.h");
+    mc_sources.push_back("fast_reco.h"); }
+  if (reco=="klfitter") {
+    klf_reco klf_config;
+    klf_config.prescreen = prescreen;
+    mc_config.push_back(klf_config.config_key()); }
+  if (get_code_key(source_dir, {"mc_inputs.h", "selection_masks.h"}, cut_key) == false) return 1;
+  if (get_code_key(source_dir, sources, code_key) == false) return 1;
+  if (get_code_key(source_dir, mc_sources, mc_key, mc_config) == false) return 1;
+
+
+  // Only the ntuples without a shard of the same ntuple, code, variations
+  // and reconstruction are processed, and with resume only their ranges not
+  // done by the interrupted run. Without a shard_dir the shards only order
+  // the sums and are removed at the end
+  vector<TString> stream_trees = {"nominal"};
+  if (reco!="") stream_trees.push_back(reco);
+  bool keep_shards = shard_dir!="";
+  if (!keep_shards) shard_dir = TString::Format("hist_shards_%d/", gSystem->GetPid());
+  hist_shards shards(shard_dir, code_key, mc_key, stream_trees, nn_writer::compression());
+  vector<mc_range> to_process = shards.missing(ranges, resume);
+
+
+
+  // Process the ranges with a pool of workers, each filling the mc or data
+  // histograms of one range at a time, saved as a range shard with the NN
+  // input events and reconstruction results of the mc nominal ranges
+  cout << "\n\n\nProcessing " << to_process.size() << " ranges" << endl;
+  hist_registry<mc_observables> registry;
+  define_hists(registry);
+  vector<hist_bank<mc_observables>> worker_hists, worker_data_hists;
+  for (int worker_i=0; worker_i<n_threads; worker_i++) {
+    worker_hists.push_back(hist_bank<mc_observables>(registry, systematics.variation_names()));
+    worker_data_hists.push_back(hist_bank<mc_observables>(registry, {"nominal"}, 256, true)); }
+  work_scheduler<mc_range> scheduler(to_process, n_threads);
+  vector<double> worker_busy_time(n_threads, 0);
+  vector<Long64_t> worker_bytes_read(n_threads, 0), worker_entries(n_threads, 0), worker_bytes_skipped(n_threads, 0);
+  TStopwatch wall_time;
+
+  auto worker = [&](int worker_i) {
+    unique_ptr<klf_reco> klf;
+    unique_ptr<mlb_reco> mlb;
+    if (reco=="klfitter") {
+      klf.reset(new klf_reco());
+      klf->prescreen = prescreen; }
+    if (reco=="mlb") mlb.reset(new mlb_reco());
+    mc_range range;
+    while (scheduler.next(worker_i, range)) {
+      TStopwatch range_time;
+      TFile *range_file = shards.open_range(range);
+      unique_ptr<nn_writer> NN_writer;
+      unique_ptr<klf_writer> reco_out;
+      if (hist_shards::streams(range)) {
+        NN_writer.reset(new nn_writer(range_file));
+        if (reco!="") reco_out.reset(new klf_writer(range_file, reco)); }
+      if (klf) klf->stats = klf_prescreen_stats();
+      if (range.is_data) worker_bytes_read[worker_i] += process_range<true>(range, systematics, cut_key, worker_data_hists[worker_i], 0, 0, 0, 0, worker_bytes_skipped[worker_i]);
+      else worker_bytes_read[worker_i] += process_range<false>(range, systematics, cut_key, worker_hists[worker_i], NN_writer.get(), klf.get(), mlb.get(), reco_out.get(), worker_bytes_skipped[worker_i]);
+      shard_counts counts;
+      if (NN_writer) {
+        NN_writer->write();
+        counts.NN_entries = NN_writer->entries(); }
+      if (reco_out) {
+        reco_out->write();
+        counts.reco = reco_out->report; }
+      if (klf) counts.prescreen = klf->stats;
+      if (range.is_data) shards.close_range(range, range_file, worker_data_hists[worker_i], counts);
+      else shards.close_range(range, range_file, worker_hists[worker_i], counts);
+      worker_entries[worker_i] += range.last - range.first;
+      worker_busy_time[worker_i] += range_time.RealTime(); } };
+
+  vector<thread> workers;
+  for (int worker_i=0; worker_i<n_threads; worker_i++) { workers.push_back(thread(worker, worker_i)); }
+  for (int worker_i=0; worker_i<n_threads; worker_i++) { workers[worker_i].join(); }
+
+
+  // Report how well the work was balanced
+  double total_busy_time = 0;
+  Long64_t total_bytes_read = 0, total_entries = 0, total_bytes_skipped = 0;
+  for (int worker_i=0; worker_i<n_threads; worker_i++) {
+    cout << "Worker " << worker_i << ": busy " << worker_busy_time[worker_i] << " s, stolen ranges " << scheduler.stolen(worker_i) << endl;
+    total_busy_time += worker_busy_time[worker_i];
+    total_bytes_read += worker_bytes_read[worker_i];
+    total_entries += worker_entries[worker_i];
+    total_bytes_skipped += worker_bytes_skipped[worker_i]; }
+  cout << "Wall time " << wall_time.RealTime() << " s, busy time / workers " << total_busy_time/n_threads << " s" << endl;
+  cout << "Read " << total_bytes_read/1024./1024. << " MB, " << total_bytes_read/1024./max(total_entries, Long64_t(1)) << " kB/event" << endl;
+  cout << "Cheap cuts saved deserialising an estimated " << total_bytes_skipped/1024./1024. << " MB of heavy branches (uncompressed, from their mean size per entry; still read from the file by the cache)" << endl;
+
+
+  // The workers emptied their histograms into the range shards: add them
+  // into the shards of the processed ntuples, then all the ntuple shards in
+  // the order of the ranges, so the sums don't depend on the number of
+  // workers nor on which worker got which range
+  hist_bank<mc_observables> &h = worker_hists[0];
+  hist_bank<mc_observables> &h_data = worker_data_hists[0];
+  // A missing or invalid shard fails the run before any output is written,
+  // the outputs would silently lack its ntuple
+  shard_counts counts;
+  if (shards.combine(h, h_data) == false || shards.merge(ranges, h, h_data, counts) == false) {
+    cout << "Some ntuples have no valid histogram shard in " << shard_dir << ", no output written" << endl;
+    return 1; }
+
+
+  // Save histograms, each under the name it was defined with (variations as <name>__<variation>)
+  if (with_mc) {
+    TFile *hists_file = new TFile("hists_mc.root", "RECREATE");
+    h.write();
+    hists_file->Close(); }
+  if (with_data) {
+    TFile *hists_file_data = new TFile("hists_data.root", "RECREATE");
+    h_data.write();
+    hists_file_data->Close(); }
+
+
+  // NN input and reconstruction results of all the ntuples, their trees
+  // concatenated in the order of the ranges. The reports sum the counts of
+  // all the ranges, whichever run processed them
+  if (with_mc) {
+    cout << "Wrote " << shards.write_stream(ranges, "nominal", "tt_jets_NN_input.root") << " events to tt_jets_NN_input.root (" << counts.NN_entries << " counted by the shards)" << endl; }
+  if (reco!="") {
+    cout << "Wrote " << shards.write_stream(ranges, reco, reco + "_results.root") << " events to " << reco << "_results.root" << endl;
+    if (reco=="klfitter") counts.prescreen.print();
+    counts.reco.print(reco); }
+  if (!keep_shards) shards.remove(ranges);
+  return 0;
 }
@@ -0,0 +1,203 @@
+#ifndef RECO_RESULTS_H
+#define RECO_RESULTS_H
+
+#include <TTree.h>
+#include <TFile.h>
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+
+#include "mc_inputs.h"
+#include "event_kinematics.h"
+
+using namespace std;
+
+
+
+// ##########################################
+// ## Best permutation of the dilepton fit ##
+// ##########################################
+struct klf_result
+{
+  int n_permutations = 0;
+  int n_fitted = 0;                // permutations left by the pre-screening
+  bool converged = false;          // minimisation of the best permutation converged
+  double log_likelihood = -1e10;
+  double log_event_probability = -1e10;
+  int b_index[2] = {-1, -1};       // jets assigned to the b of the electron and of the muon
+  double top_mass = 0;             // fitted, or the fixed value
+  double mlb[2] = {0, 0};          // electron + its b, muon + its b [GeV]
+  double score = 0;                // pairing score of the fast reconstruction (fast_reco.h)
+};
+
+
+
+// Jet is a b from top in truth
+inline bool is_b_from_top(const mc_event &ev, int jet_i) { return (*ev.jet_truthflav)[jet_i]==5 && (*ev.topHadronOriginFlag)[jet_i]==4; }
+
+
+
+// How often the assigned b are the b from the tops, over the events where
+// both b from top are among the reconstructed jets, and the time spent
+// reconstructing (including cache look-ups)
+struct reco_report
+{
+  Long64_t events = 0, truth_events = 0, correct = 0;
+  double seconds = 0;
+
+  void add(const mc_event &ev, const klf_result &result, int n_jets)
+  {
+    events++;
+    int n_b_from_top = 0;
+    for (int i=0; i<min(n_jets, int(ev.jet_pt->size())); i++) { if (is_b_from_top(ev, i)) n_b_from_top++; }
+    if (n_b_from_top < 2) return;
+    truth_events++;
+    if (result.b_index[0] >= 0 && result.b_index[1] >= 0 && is_b_from_top(ev, result.b_index[0]) && is_b_from_top(ev, result.b_index[1])) correct++;
+  }
+
+  void add(const reco_report &other)
+  {
+    events += other.events;
+    truth_events += other.truth_events;
+    correct += other.correct;
+    seconds += other.seconds;
+  }
+
+  void print(TString reco) const
+  {
+    cout << reco << ": b from top assigned in " << correct << " of " << truth_events << " events with both in the jets ("
+         << double(correct)/max(truth_events, Long64_t(1)) << "), " << events << " events reconstructed in "
+         << seconds << " s of workers' time (" << 1e6*seconds/max(events, Long64_t(1)) << " us/event)" << endl;
+  }
+};
+
+
+
+// ##########################################################################
+// ## Cheap cuts on the jet-lepton assignment of a permutation before fits ##
+// ##########################################################################
+//
+// The b of each lepton has to pass the m(lb) endpoint, sqrt(m_t^2 - m_W^2)
+// ~ 153 GeV plus resolution, and be close to its lepton; optionally both
+// b have to be among the highest DL1r jets. The permutations left are
+// ranked by m(lb) of the two pairs and only keep_fraction of them is fitted.
+// An event always keeps at least its best-ranked permutation.
+struct klf_prescreen
+{
+  bool enabled = false;
+  double mlb_max = 160;        // [GeV]
+  double dR_lep_b_max = 2.5;
+  int DL1r_rank_max = 0;       // b among the N highest DL1r jets, 0: no requirement
+  double keep_fraction = 0.5;
+
+
+  bool passes(int b_el, int b_mu, const event_kinematics &kin, const vector<int> &DL1r_rank) const
+  {
+    if (kin.mass_jet_lep(b_el, 0) > mlb_max || kin.mass_jet_lep(b_mu, 1) > mlb_max) return false;
+    if (kin.dR_jet_lep(b_el, 0) > dR_lep_b_max || kin.dR_jet_lep(b_mu, 1) > dR_lep_b_max) return false;
+    if (DL1r_rank_max > 0 && (DL1r_rank[b_el] >= DL1r_rank_max || DL1r_rank[b_mu] >= DL1r_rank_max)) return false;
+    return true;
+  }
+
+
+  static double score(int b_el, int b_mu, const event_kinematics &kin) { return kin.mass_jet_lep(b_el, 0) + kin.mass_jet_lep(b_mu, 1); }
+
+
+  // Part of the fit configuration, cached fits depend on it
+  TString key() const
+  {
+    if (enabled == false) return "";
+    return TString::Format("_mlb%g_dR%g_DL1r%d_keep%g", mlb_max, dR_lep_b_max, DL1r_rank_max, keep_fraction);
+  }
+};
+
+
+
+// Permutations kept by the pre-screening, and how often the truth-correct
+// assignment (both b candidates are b from top) survives it
+struct klf_prescreen_stats
+{
+  Long64_t permutations = 0, kept = 0;
+  Long64_t truth_events = 0, truth_kept = 0;
+
+  void add(const klf_prescreen_stats &other)
+  {
+    permutations += other.permutations;
+    kept += other.kept;
+    truth_events += other.truth_events;
+    truth_kept += other.truth_kept;
+  }
+
+  void print() const
+  {
+    cout << "KLFitter pre-screening: kept " << kept << " of " << permutations << " permutations ("
+         << double(kept)/max(permutations, Long64_t(1)) << "), truth-correct permutation kept in "
+         << truth_kept << " of " << truth_events << " events (" << double(truth_kept)/max(truth_events, Long64_t(1)) << ")" << endl;
+  }
+};
+
+
+
+// #######################################################################
+// ## Dilepton reconstruction results of one range, one entry per event ##
+// #######################################################################
+//
+// Written like nn_writer.h: the tree of a range goes to its range shard and
+// the trees are concatenated in range order. Also counts how often the
+// assignment is right in truth, over the leading n_jets.
+class klf_writer
+{
+public:
+  klf_writer(TFile *range_file, TString tree_name = "klfitter", int n_jets = 3, Long64_t flush_entries = 10000)
+    : n_jets(n_jets)
+  {
+    tree = new TTree(tree_name, "dilepton reconstruction");
+    tree->SetDirectory(range_file);
+    tree->SetAutoFlush(flush_entries);
+    tree->Branch("runNumber", &runNumber, "runNumber/i");
+    tree->Branch("eventNumber", &eventNumber, "eventNumber/l");
+    tree->Branch("weight", &weight, "weight/D");
+    tree->Branch("n_permutations", &result.n_permutations, "n_permutations/I");
+    tree->Branch("converged", &result.converged, "converged/O");
+    tree->Branch("log_likelihood", &result.log_likelihood, "log_likelihood/D");
+    tree->Branch("log_event_probability", &result.log_event_probability, "log_event_probability/D");
+    tree->Branch("b_index", result.b_index, "b_index[2]/I");
+    tree->Branch("top_mass", &result.top_mass, "top_mass/D");
+    tree->Branch("mlb", result.mlb, "mlb[2]/D");
+    tree->Branch("score", &result.score, "score/D");
+  }
+
+
+  void fill(const mc_event &ev, double event_weight, const klf_result &event_result)
+  {
+    runNumber = ev.runNumber;
+    eventNumber = ev.eventNumber;
+    weight = event_weight;
+    result = event_result;
+    report.add(ev, event_result, n_jets);
+    tree->Fill();
+  }
+
+
+  // Write the tree to the range file, once all the events are filled
+  void write() { tree->Write("", TObject::kOverwrite); }
+
+
+  Long64_t entries() const { return tree->GetEntries(); }
+
+
+  reco_report report;
+
+
+private:
+  TTree *tree;
+  int n_jets;
+
+  UInt_t runNumber = 0;
+  ULong64_t eventNumber = 0;
+  double weight = 0;
+  klf_result result;
+};
+
+#endif
@@ -0,0 +1,67 @@
+#include <TROOT.h>
+#include <TH1.h>
+#include <TFile.h>
+#include <TStopwatch.h>
+#include <ROOT/TBufferMerger.hxx>
+
+#include <iostream>
+#include <vector>
+#include <thread>
+
+#include "work_scheduler.h"
+#include "template_fit_scan.h"
+#include "toy_engine.h"
+
+using namespace std;
+
+
+
+// ##############
+// ##   MAIN   ##
+// ##############
+// n_toys pseudo-experiments per configuration of toy_configs.txt, from the
+// DL1r templates of the given tag (2: 3rd tag), results in toy_results.root
+// for plot_fit_results.c
+void run_toys(Long64_t n_toys = 100000, TString configs_path = "toy_configs.txt", TString templates_path = "hists_mc.root", int tag_i = 2,
+              int n_threads = 0, TString results_path = "toy_results.root", ULong64_t seed = 1)
+{
+  // Run over all the cores by default
+  if (n_threads <= 0) n_threads = thread::hardware_concurrency();
+  if (n_threads <= 0) n_threads = 1;
+  ROOT::EnableThreadSafety();
+  TH1::AddDirectory(kFALSE);
+
+
+  // Templates and configurations
+  TFile *templates_file = TFile::Open(templates_path);
+  TH1 *templates[n_processes];
+  if (get_dl1r_templates(templates_file, tag_i, templates)==false) return;
+  vector<toy_config> configs = read_toy_configs(configs_path);
+  cout << "Running " << n_toys << " toys for each of " << configs.size() << " configurations with " << n_threads << " worker threads" << endl;
+
+
+  // Blocks of toys dealt to the workers, every worker streaming its fits
+  vector<toy_block> blocks = get_toy_blocks(configs.size(), n_toys, 10000);
+  work_scheduler<toy_block> scheduler(blocks, n_threads);
+  ROOT::Experimental::TBufferMerger merger(results_path);
+  vector<Long64_t> worker_toys(n_threads, 0);
+  TStopwatch wall_time;
+
+  auto worker = [&](int worker_i) {
+    toy_engine engine(templates, configs, merger, seed);
+    toy_block block;
+    while (scheduler.next(worker_i, block)) { engine.run(block); }
+    engine.write();
+    worker_toys[worker_i] = engine.toys_done(); };
+
+  vector<thread> workers;
+  for (int worker_i=0; worker_i<n_threads; worker_i++) { workers.push_back(thread(worker, worker_i)); }
+  for (int worker_i=0; worker_i<n_threads; worker_i++) { workers[worker_i].join(); }
+
+
+  Long64_t total_toys = 0;
+  for (int worker_i=0; worker_i<n_threads; worker_i++) { total_toys += worker_toys[worker_i]; }
+  cout << "Wall time " << wall_time.RealTime() << " s for " << total_toys << " toys, written to " << results_path << endl;
+  cout << "Run plot_fit_results(\"" << results_path << "\") to draw them" << endl;
+  templates_file->Close();
+}
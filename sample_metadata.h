@@ -0,0 +1,140 @@
+#ifndef SAMPLE_METADATA_H
+#define SAMPLE_METADATA_H
+
+#include <TTree.h>
+#include <TFile.h>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <cmath>
+
+using namespace std;
+
+
+
+// #########################################
+// ## Cross-section info of one MC sample ##
+// #########################################
+struct sample_info
+{
+  int DID;
+  double xsection;   // [nb]
+  double genFiltEff;
+  double kFactor;
+  int topHFFF;       // topHeavyFlavorFilterFlag kept for the sample, -1 keeps all
+  TString name;
+};
+
+
+
+// #######################################################
+// ## Sum of the weights of the events of one MC ntuple ##
+// #######################################################
+// From its "sumWeights" bookkeeping tree, -1 if there is none
+double read_sum_weights(TFile *ntuple)
+{
+  TTree *tree_sumWeights = (TTree*)ntuple->Get("sumWeights");
+  if (!tree_sumWeights) { cout << "No sumWeights tree in " << ntuple->GetName() << endl; return -1; }
+
+  Float_t totalEventsWeighted = 0;
+  double sum = 0;
+  tree_sumWeights->SetBranchStatus("*", 0);
+  tree_sumWeights->SetBranchStatus("totalEventsWeighted", 1);
+  tree_sumWeights->SetBranchAddress("totalEventsWeighted", &totalEventsWeighted);
+  for (Long64_t entry=0; entry<tree_sumWeights->GetEntries(); entry++) {
+    tree_sumWeights->GetEntry(entry);
+    sum += totalEventsWeighted; }
+  return sum;
+}
+
+
+
+// #############################################
+// ## Integrated luminosity of an MC campaign ##
+// #############################################
+double get_campaign_lumi(TString campaign)
+{
+  // [fb-1]
+  if (campaign=="mc16a") return 3.21956 + 32.9881;
+  if (campaign=="mc16d") return 44.3074;
+  if (campaign=="mc16e") return 58.4501;
+  cout << "Unknown campaign " << campaign << ", luminosity set to 1" << endl;
+  return 1;
+}
+
+
+
+// ###################################################
+// ## Normalisation of the MC samples, one per file ##
+// ###################################################
+//
+// Cross-sections come from a table file (sample_metadata.txt), the sums of
+// weights from the "sumWeights" bookkeeping tree of every ntuple, kept in
+// the input catalog (input_catalog.h). All of it
+// is resolved when the ntuples are listed, so that the event loop only
+// multiplies by one factor per file.
+class sample_metadata
+{
+public:
+  // Read the table of samples, false if the file can't be read
+  bool read_table(TString table_path)
+  {
+    ifstream table(table_path.Data());
+    if (!table.is_open()) { cout << "Can't open sample table " << table_path << endl; return false; }
+
+    string line;
+    while (getline(table, line)) {
+      if (line.empty() || line[0]=='#') continue;
+      istringstream columns(line);
+      sample_info info;
+      string name;
+      if (!(columns >> info.DID >> info.xsection >> info.genFiltEff >> info.kFactor >> info.topHFFF)) continue;
+      columns >> name;
+      info.name = name;
+      samples[info.DID] = info; }
+
+    cout << "Read " << samples.size() << " samples from " << table_path << endl;
+    return true;
+  }
+
+
+  bool has(int DID) const { return samples.count(DID) > 0; }
+  const sample_info &info(int DID) const { return samples.at(DID); }
+
+
+  // Add the sum of weights of one ntuple (see read_sum_weights()) to its sample and campaign
+  void add_sum_weights(int DID, TString campaign, double ntuple_sum_weights)
+  {
+    sum_weights[make_pair(DID, campaign)] += ntuple_sum_weights;
+  }
+
+
+  // Factor turning the product of the event weights into events per full luminosity
+  double norm_factor(int DID, TString campaign) const
+  {
+    if (!has(DID)) return 1;
+    const sample_info &sample = info(DID);
+    map<pair<int, TString>, double>::const_iterator sum = sum_weights.find(make_pair(DID, campaign));
+    if (sum == sum_weights.end() || sum->second == 0) { cout << "No sum of weights for " << DID << " " << campaign << endl; return 0; }
+    return get_campaign_lumi(campaign) * sample.xsection * pow(10,6) * sample.genFiltEff * sample.kFactor / sum->second;
+  }
+
+
+  // Print the resolved normalisation of every sample
+  void print() const
+  {
+    for (map<pair<int, TString>, double>::const_iterator sum=sum_weights.begin(); sum!=sum_weights.end(); sum++) {
+      cout << sum->first.first << " " << sum->first.second << ": sumWeights = " << sum->second << ", norm. factor = " << norm_factor(sum->first.first, sum->first.second) << endl; }
+  }
+
+
+private:
+  map<int, sample_info> samples;
+  map<pair<int, TString>, double> sum_weights;
+};
+
+#endif
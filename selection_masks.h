@@ -0,0 +1,150 @@
+#ifndef SELECTION_MASKS_H
+#define SELECTION_MASKS_H
+
+#include <TTree.h>
+#include <TFile.h>
+#include <TSystem.h>
+
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+
+
+// #############################################
+// ## Bits of the per-event selection bitmask ##
+// #############################################
+enum selection_bit
+{
+  emu_bit      = 1 << 0,
+  OS_bit       = 1 << 1,
+  jets_n_bit   = 1 << 2,
+  btags_n2_bit = 1 << 3,
+  bjets_n2_bit = 1 << 4,
+  bjets_n3_bit = 1 << 5,
+  topHFFF_bit  = 1 << 6
+};
+
+// Bits of truth cuts, never set for data
+const UInt_t truth_bits = bjets_n2_bit | bjets_n3_bit;
+
+
+
+// ###########################################################
+// ## Cut results of a range of entries, saved between runs ##
+// ###########################################################
+//
+// The first run over a range computes the cuts of every entry and writes
+// them packed into one UInt_t per entry, in a small "selection" tree
+// stored next to the macros (selection_masks/). The entries of that tree
+// follow the entries [first, last) of the ntuple, so it works as a friend
+// of the range. Later runs read it and skip non-selected entries without
+// touching the ntuple. The file is stored with a key, the size and mtime
+// of the ntuple and the hash of the cut code (code_key.h): masks of an
+// ntuple rewritten at the same path or of other cuts are recomputed.
+class selection_masks
+{
+public:
+  // Layout of the masks, part of the key: 2 since data are cut by the mc
+  // code (data masks of version 1 have no jets_n bit in the 2+ b-tag region)
+  static const int format_version = 2;
+
+
+  selection_masks(TString ntuple_path, Long64_t first, Long64_t last, TString tree_name, TString key, TString dir = "selection_masks/")
+    : first(first), last(last), key(key + " v" + to_string(format_version))
+  {
+    TString base_name = gSystem->BaseName(ntuple_path);
+    base_name.ReplaceAll(".root", "");
+    if (tree_name != "nominal") base_name += "_" + tree_name;
+    mask_path = dir + base_name + "_" + to_string(ntuple_path.Hash()) + "_" + to_string(first) + "_" + to_string(last) + ".root";
+    mask_dir = dir;
+  }
+
+
+  // Read the masks of an earlier run, false if there are none for the range
+  bool read()
+  {
+    if (gSystem->AccessPathName(mask_path)) return false;
+    TFile *mask_file = new TFile (mask_path);
+    TTree *tree_selection = (TTree*)mask_file->Get("selection");
+    bool complete = tree_selection && tree_selection->GetEntries() == last - first && read_key(mask_file) == key;
+    if (complete) {
+      UInt_t mask = 0;
+      tree_selection->SetBranchAddress("mask", &mask);
+      masks.resize(last - first);
+      for (Long64_t entry=0; entry<last-first; entry++) {
+        tree_selection->GetEntry(entry);
+        masks[entry] = mask; } }
+    mask_file->Close();
+    delete mask_file;
+    known = complete;
+    return complete;
+  }
+
+
+  // True if the masks come from an earlier run
+  bool from_earlier_run() const { return known; }
+
+
+  // All the given bits are set for the entry of the ntuple
+  bool has_all(Long64_t entry, UInt_t bits) const { return (masks[entry - first] & bits) == bits; }
+
+  // At least one of the given bits is set for the entry of the ntuple
+  bool has_any(Long64_t entry, UInt_t bits) const { return (masks[entry - first] & bits) != 0; }
+
+
+  // Record the mask of an entry of the ntuple during the first run
+  void set(Long64_t entry, UInt_t mask)
+  {
+    if (masks.empty()) masks.resize(last - first, 0);
+    masks[entry - first] = mask;
+  }
+
+
+  // Save the masks recorded during the first run
+  void write()
+  {
+    if (known) return;
+    if (masks.empty()) masks.resize(last - first, 0);
+    gSystem->mkdir(mask_dir, kTRUE);
+    TFile *mask_file = new TFile (mask_path, "RECREATE");
+    TTree *tree_selection = new TTree("selection", "selection");
+    UInt_t mask = 0;
+    tree_selection->Branch("mask", &mask, "mask/i");
+    for (Long64_t entry=0; entry<last-first; entry++) {
+      mask = masks[entry];
+      tree_selection->Fill(); }
+    tree_selection->Write();
+    TTree *tree_key = new TTree("key", "ntuple and cut code of the masks");
+    tree_key->Branch("key", &key);
+    tree_key->Fill();
+    tree_key->Write();
+    mask_file->Close();
+    delete mask_file;
+  }
+
+
+private:
+  // Key the masks were written with, "" for masks without one
+  static TString read_key(TFile *mask_file)
+  {
+    TTree *tree_key = (TTree*)mask_file->Get("key");
+    if (!tree_key || tree_key->GetEntries() != 1) return "";
+    TString *stored_key = 0;
+    tree_key->SetBranchAddress("key", &stored_key);
+    tree_key->GetEntry(0);
+    TString stored = *stored_key;
+    tree_key->ResetBranchAddresses();
+    delete stored_key;
+    return stored;
+  }
+
+  Long64_t first, last;
+  TString key;
+  TString mask_path, mask_dir;
+  vector<UInt_t> masks;
+  bool known = false;
+};
+
+#endif
@@ -0,0 +1,126 @@
+#include <TROOT.h>
+#include <TTree.h>
+#include <TFile.h>
+#include <TStopwatch.h>
+#include <ROOT/TBufferMerger.hxx>
+
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <memory>
+
+#include "work_scheduler.h"
+#include "branch_manifest.h"
+#include "mc_inputs.h"
+
+using namespace std;
+
+
+
+// Workers share std::cout
+mutex cout_mutex;
+
+
+
+// ####################################################
+// ## Skim a range of entries into the merger's file ##
+// ####################################################
+Long64_t skim_mc_range(const mc_range &range, ROOT::Experimental::TBufferMerger &merger, Long64_t &n_passed, Long64_t &bytes_skipped)
+{
+  { lock_guard<mutex> lock(cout_mutex);
+    cout << range.path << "\t[" << range.first << ", " << range.last << ")" << endl; }
+  TFile *ntuple = new TFile (range.path);
+  TTree *tree_nominal = (TTree*)ntuple->Get("nominal");
+
+  // Read only the branches that the histogramming uses
+  branch_manifest branches;
+  mc_event ev;
+  ev.declare(branches, false);
+  branches.attach(tree_nominal, range.first, range.last);
+
+  // Output tree of this range, flushed into the merged file when written
+  shared_ptr<ROOT::Experimental::TBufferMergerFile> skim_file = merger.GetFile();
+  TTree *skim_tree = new TTree("nominal", "nominal");
+  skim_tree->SetDirectory(skim_file.get());
+  ev.book_skim_branches(skim_tree);
+  ev.sample_DID = range.sample_DID;
+
+
+  // Loop over entries of the range
+  for (Long64_t entry=range.first; entry<range.last; entry++)
+    {
+      // Loosest selection common to all the regions of prepare_hists_mc.c,
+      // heavy branches are loaded only for events passing the cheap cuts
+      branches.load_first(entry);
+      if (passes_preselection(ev, range)==false) { branches.skip_rest(); continue; }
+      branches.load_rest(entry);
+      mc_cuts cuts = get_mc_cuts(ev, range);
+      if (cuts.btags_n2_cut==false && cuts.bjets_n2_cut==false && cuts.bjets_n3_cut==false) continue;
+
+      // Fold the normalisation and scale factors into one weight
+      ev.weight_norm = ev.w_mc * ev.w_pu * ev.w_leptonSF * ev.w_DL1r_77 * ev.w_jvt * range.norm_factor;
+      skim_tree->Fill();
+      n_passed++;
+
+    } // [entry] - loop over entries of the range
+
+
+  skim_file->Write();
+  Long64_t bytes_read = branches.bytes_read();
+  bytes_skipped += branches.bytes_skipped();
+  ntuple->Close();
+  delete ntuple;
+
+  return bytes_read;
+}
+
+
+
+// ##############
+// ##   MAIN   ##
+// ##############
+void skim_mc(int n_threads = 0, TString skim_path = "skim_mc.root", Long64_t entries_per_range = 200000)
+{
+  // Run over all the cores by default
+  if (n_threads <= 0) n_threads = thread::hardware_concurrency();
+  if (n_threads <= 0) n_threads = 1;
+  ROOT::EnableThreadSafety();
+  cout << "Running with " << n_threads << " worker threads" << endl;
+
+
+  // Same ranges of entries as in prepare_hists_mc.c
+  TString path_to_ntuples = "/eos/user/e/eantipov/Files/tt_hf/";
+  vector<mc_range> ranges = get_list_of_ranges(path_to_ntuples, entries_per_range);
+
+
+  // Workers write their ranges into a single skim file
+  cout << "\n\n\nSkimming " << ranges.size() << " ranges into " << skim_path << endl;
+  ROOT::Experimental::TBufferMerger merger(skim_path);
+  work_scheduler<mc_range> scheduler(ranges, n_threads);
+  vector<Long64_t> worker_bytes_read(n_threads, 0), worker_entries(n_threads, 0), worker_passed(n_threads, 0), worker_bytes_skipped(n_threads, 0);
+  TStopwatch wall_time;
+
+  auto worker = [&](int worker_i) {
+    mc_range range;
+    while (scheduler.next(worker_i, range)) {
+      worker_bytes_read[worker_i] += skim_mc_range(range, merger, worker_passed[worker_i], worker_bytes_skipped[worker_i]);
+      worker_entries[worker_i] += range.last - range.first; } };
+
+  vector<thread> workers;
+  for (int worker_i=0; worker_i<n_threads; worker_i++) { workers.push_back(thread(worker, worker_i)); }
+  for (int worker_i=0; worker_i<n_threads; worker_i++) { workers[worker_i].join(); }
+
+
+  // Report
+  Long64_t total_bytes_read = 0, total_entries = 0, total_passed = 0, total_bytes_skipped = 0;
+  for (int worker_i=0; worker_i<n_threads; worker_i++) {
+    total_bytes_read += worker_bytes_read[worker_i];
+    total_entries += worker_entries[worker_i];
+    total_passed += worker_passed[worker_i];
+    total_bytes_skipped += worker_bytes_skipped[worker_i]; }
+  cout << "Wall time " << wall_time.RealTime() << " s, read " << total_bytes_read/1024./1024. << " MB, "
+       << "an estimated " << total_bytes_skipped/1024./1024. << " MB of heavy branches not deserialised (uncompressed, still read by the cache)" << endl;
+  cout << "Kept " << total_passed << " of " << total_entries << " events" << endl;
+  cout << "Run prepare_hists_mc(n_threads, entries_per_range, \"" << skim_path << "\") to histogram the skim" << endl;
+}
@@ -0,0 +1,41 @@
+#ifndef COMMAND_LINE_H
+#define COMMAND_LINE_H
+
+#include <TString.h>
+
+#include <iostream>
+#include <cstdlib>
+
+using namespace std;
+
+
+
+// ###############################################################
+// ## Positional arguments of a macro given on the command line ##
+// ###############################################################
+//
+// The executables of standalone/ take the arguments of their macro in the
+// same order; the ones left out keep the defaults of the macro, so every
+// main() calls the macro with as many arguments as it was given.
+struct command_line
+{
+  int argc;
+  char **argv;
+
+  int n() const { return argc - 1; }
+
+  TString text(int i) const { return argv[i+1]; }
+  int integer(int i) const { return atoi(argv[i+1]); }
+  Long64_t long_integer(int i) const { return atoll(argv[i+1]); }
+  double real(int i) const { return atof(argv[i+1]); }
+  bool flag(int i) const { return text(i)=="1" || text(i)=="true"; }
+
+  bool usage(int max_n, const char *arguments) const
+  {
+    if (n() <= max_n) return false;
+    cout << "Usage: " << argv[0] << " " << arguments << endl;
+    return true;
+  }
+};
+
+#endif
@@ -0,0 +1,15 @@
+#include "draw_hists.c"
+#include "command_line.h"
+
+
+
+int main(int argc, char **argv)
+{
+  command_line a = {argc, argv};
+  if (a.usage(2, "[n_workers] [pdf_path]")) return 1;
+  switch (a.n()) {
+  case 0: draw_hists(); break;
+  case 1: draw_hists(a.integer(0)); break;
+  case 2: draw_hists(a.integer(0), a.text(1)); break; }
+  return 0;
+}
@@ -0,0 +1,17 @@
+#include "prepare_hists_data.c"
+#include "command_line.h"
+
+
+
+int main(int argc, char **argv)
+{
+  command_line a = {argc, argv};
+  if (a.usage(3, "[n_threads] [entries_per_range] [resume]")) return 1;
+  int status = 0;
+  switch (a.n()) {
+  case 0: status = prepare_hists_data(); break;
+  case 1: status = prepare_hists_data(a.integer(0)); break;
+  case 2: status = prepare_hists_data(a.integer(0), a.long_integer(1)); break;
+  case 3: status = prepare_hists_data(a.integer(0), a.long_integer(1), a.flag(2)); break; }
+  return status;
+}
@@ -0,0 +1,28 @@
+#include "prepare_hists_mc.c"
+#include "command_line.h"
+
+
+
+int main(int argc, char **argv)
+{
+  command_line a = {argc, argv};
+  if (a.usage(13, "[n_threads] [entries_per_range] [skim_path] [systematics_path] [reco] [klfitter_prescreen] [samples] [shard_dir] [resume]"
+                  " [prescreen_keep_fraction] [prescreen_mlb_max] [prescreen_dR_lep_b_max] [prescreen_DL1r_rank_max]")) return 1;
+  int status = 0;
+  switch (a.n()) {
+  case 0: status = prepare_hists_mc(); break;
+  case 1: status = prepare_hists_mc(a.integer(0)); break;
+  case 2: status = prepare_hists_mc(a.integer(0), a.long_integer(1)); break;
+  case 3: status = prepare_hists_mc(a.integer(0), a.long_integer(1), a.text(2)); break;
+  case 4: status = prepare_hists_mc(a.integer(0), a.long_integer(1), a.text(2), a.text(3)); break;
+  case 5: status = prepare_hists_mc(a.integer(0), a.long_integer(1), a.text(2), a.text(3), a.text(4)); break;
+  case 6: status = prepare_hists_mc(a.integer(0), a.long_integer(1), a.text(2), a.text(3), a.text(4), a.flag(5)); break;
+  case 7: status = prepare_hists_mc(a.integer(0), a.long_integer(1), a.text(2), a.text(3), a.text(4), a.flag(5), a.text(6)); break;
+  case 8: status = prepare_hists_mc(a.integer(0), a.long_integer(1), a.text(2), a.text(3), a.text(4), a.flag(5), a.text(6), a.text(7)); break;
+  case 9: status = prepare_hists_mc(a.integer(0), a.long_integer(1), a.text(2), a.text(3), a.text(4), a.flag(5), a.text(6), a.text(7), a.flag(8)); break;
+  case 10: status = prepare_hists_mc(a.integer(0), a.long_integer(1), a.text(2), a.text(3), a.text(4), a.flag(5), a.text(6), a.text(7), a.flag(8), a.real(9)); break;
+  case 11: status = prepare_hists_mc(a.integer(0), a.long_integer(1), a.text(2), a.text(3), a.text(4), a.flag(5), a.text(6), a.text(7), a.flag(8), a.real(9), a.real(10)); break;
+  case 12: status = prepare_hists_mc(a.integer(0), a.long_integer(1), a.text(2), a.text(3), a.text(4), a.flag(5), a.text(6), a.text(7), a.flag(8), a.real(9), a.real(10), a.real(11)); break;
+  case 13: status = prepare_hists_mc(a.integer(0), a.long_integer(1), a.text(2), a.text(3), a.text(4), a.flag(5), a.text(6), a.text(7), a.flag(8), a.real(9), a.real(10), a.real(11), a.integer(12)); break; }
+  return status;
+}
@@ -0,0 +1,18 @@
+#include "study_dl1r_templates.c"
+#include "command_line.h"
+
+
+
+int main(int argc, char **argv)
+{
+  command_line a = {argc, argv};
+  if (a.usage(5, "[grid_definition] [n_threads] [results_path] [fitter_name] [pdf_path]")) return 1;
+  switch (a.n()) {
+  case 0: study_dl1r_templates(); break;
+  case 1: study_dl1r_templates(a.text(0)); break;
+  case 2: study_dl1r_templates(a.text(0), a.integer(1)); break;
+  case 3: study_dl1r_templates(a.text(0), a.integer(1), a.text(2)); break;
+  case 4: study_dl1r_templates(a.text(0), a.integer(1), a.text(2), a.text(3)); break;
+  case 5: study_dl1r_templates(a.text(0), a.integer(1), a.text(2), a.text(3), a.text(4)); break; }
+  return 0;
+}
@@ -0,0 +1,123 @@
+#ifndef SYSTEMATICS_H
+#define SYSTEMATICS_H
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "branch_manifest.h"
+
+using namespace std;
+
+
+
+// ############################################################
+// ## A variation replacing one factor of the nominal weight ##
+// ############################################################
+enum weight_factor { factor_mc, factor_pileup, factor_leptonSF, factor_bTagSF_DL1r_77, factor_jvt };
+
+struct weight_variation
+{
+  TString name;
+  weight_factor factor;
+  TString branch;
+  int index;                  // element of a vector branch, -1 for scalar branches
+  Float_t value = 1;          // read from scalar branches
+  vector<Float_t> *values = 0; // read from vector branches
+
+
+  void declare(branch_manifest &branches)
+  {
+    if (index < 0) branches.read(branch, &value);
+    else branches.read(branch, &values);
+  }
+
+
+  // Value of the varied factor for the current entry
+  double get() const
+  {
+    if (index < 0) return value;
+    if (values && index < values->size()) return (*values)[index];
+    return 1;
+  }
+};
+
+
+
+// ############################################
+// ## Weight and tree variations of one pass ##
+// ############################################
+//
+// Variation 0 is always the nominal, then come the weight variations (filled
+// from the nominal tree in the same read) and then the tree variations
+// (other trees of the same ntuples, scheduled as more ranges of the pass).
+class systematics_config
+{
+public:
+  // Read the list of variations, an empty list if the file can't be read
+  bool read(TString config_path)
+  {
+    ifstream config(config_path.Data());
+    if (!config.is_open()) { cout << "Can't open " << config_path << ", running the nominal only" << endl; return false; }
+
+    string line;
+    while (getline(config, line)) {
+      if (line.empty() || line[0]=='#') continue;
+      istringstream columns(line);
+      string kind, name;
+      columns >> kind >> name;
+
+      if (kind=="tree") { trees.push_back(name); continue; }
+
+      string factor, branch;
+      int index = -1;
+      columns >> factor >> branch;
+      if (!(columns >> index)) index = -1;
+      weight_variation variation;
+      variation.name = name;
+      variation.branch = branch;
+      variation.index = index;
+      if (factor=="mc") variation.factor = factor_mc;
+      else if (factor=="pileup") variation.factor = factor_pileup;
+      else if (factor=="leptonSF") variation.factor = factor_leptonSF;
+      else if (factor=="bTagSF_DL1r_77") variation.factor = factor_bTagSF_DL1r_77;
+      else if (factor=="jvt") variation.factor = factor_jvt;
+      else { cout << "Unknown weight factor " << factor << " of " << name << ", skipped" << endl; continue; }
+      weights.push_back(variation); }
+
+    cout << "Systematics: " << weights.size() << " weight and " << trees.size() << " tree variations" << endl;
+    return true;
+  }
+
+
+  // Names of all the variations, in the order of the histogram banks
+  vector<TString> variation_names() const
+  {
+    vector<TString> names = {"nominal"};
+    for (int i=0; i<weights.size(); i++) { names.push_back(weights[i].name); }
+    for (int i=0; i<trees.size(); i++) { names.push_back(trees[i]); }
+    return names;
+  }
+
+
+  // Every variation with what it varies, to key results filled with them
+  vector<TString> definitions() const
+  {
+    vector<TString> lines;
+    for (int i=0; i<weights.size(); i++) { lines.push_back(weights[i].name + " " + to_string(weights[i].factor) + " " + weights[i].branch + " " + to_string(weights[i].index)); }
+    for (int i=0; i<trees.size(); i++) { lines.push_back("tree " + trees[i]); }
+    return lines;
+  }
+
+
+  // Index of the first tree variation in variation_names()
+  int first_tree_variation() const { return 1 + weights.size(); }
+
+
+  vector<weight_variation> weights;
+  vector<TString> trees;
+};
+
+#endif
@@ -0,0 +1,344 @@
+#ifndef TEMPLATE_FIT_SCAN_H
+#define TEMPLATE_FIT_SCAN_H
+
+#include <TH1.h>
+#include <TH1D.h>
+#include <TFile.h>
+#include <TTree.h>
+#include <TObjArray.h>
+#include <TFractionFitter.h>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cmath>
+
+#include "binned_template_fit.h"
+
+using namespace std;
+
+
+
+// Reference order of the processes: 2b1l, 4b, 3b, 2b1c
+static const int n_processes = 4;
+
+
+
+// ####################################################
+// ## DL1r templates of the four processes for a tag ##
+// ####################################################
+//
+// tag_i 0, 1, 2 for the 1st, 2nd, 3rd tag, read from hists_mc.root
+// (DL1r_templates_<process>_<tag>_tag) or from tagger_templates.root
+// (mc16_tag<tag_i>_DL1_TopHFFF<process>)
+bool get_dl1r_templates(TFile *file, int tag_i, TH1 **templates)
+{
+  vector<TString> processes = {"2b1l", "4b", "3b", "2b1c"};
+  vector<TString> tags = {"1st", "2nd", "3rd"};
+  for (int process_i=0; process_i<n_processes; process_i++) {
+    templates[process_i] = (TH1*)file->Get("DL1r_templates_"+processes[process_i]+"_"+tags[tag_i]+"_tag");
+    if (!templates[process_i]) templates[process_i] = (TH1*)file->Get(TString::Format("mc16_tag%d_DL1_TopHFFF%d", tag_i, process_i));
+    if (!templates[process_i]) { cout << "No " << processes[process_i] << " template of tag " << tag_i << " in " << file->GetName() << endl; return false; } }
+  return true;
+}
+
+
+
+// ###################################################
+// ## One mixture of the templates to fit in a scan ##
+// ###################################################
+struct fraction_point
+{
+  int index;
+  double fractions[n_processes];
+  Long64_t size = 1;   // cost for work_scheduler.h, all points cost the same
+};
+
+
+
+// The nine mixtures studied so far
+vector<fraction_point> get_default_fraction_grid()
+{
+  vector<double> fraction_2b1l = {0.30, 0.30, 0.30, 0.35, 0.35, 0.35, 0.40, 0.40, 0.40};
+  vector<double> fraction_4b   = {0.15, 0.15, 0.10, 0.15, 0.10, 0.10, 0.10, 0.10, 0.10};
+  vector<double> fraction_3b   = {0.30, 0.25, 0.25, 0.25, 0.25, 0.20, 0.25, 0.20, 0.15};
+  vector<double> fraction_2b1c = {0.25, 0.30, 0.35, 0.25, 0.30, 0.35, 0.25, 0.30, 0.35};
+  vector<fraction_point> grid(fraction_2b1l.size());
+  for (int i=0; i<grid.size(); i++) {
+    grid[i].index = i;
+    grid[i].fractions[0] = fraction_2b1l[i];
+    grid[i].fractions[1] = fraction_4b[i];
+    grid[i].fractions[2] = fraction_3b[i];
+    grid[i].fractions[3] = fraction_2b1c[i]; }
+  return grid;
+}
+
+
+
+// ###########################################################
+// ## Grid of mixtures: a simplex sweep or a list of points ##
+// ###########################################################
+//
+// "simplex:<step>[:<min>]" sweeps all the fractions on multiples of step,
+// each at least min, summing to one (e.g. simplex:0.01 gives 176851
+// points); step has to divide one. Anything else is read as a text file with the four fractions
+// of a point per line, "#" lines are comments. An empty grid gives the
+// default nine points.
+vector<fraction_point> get_fraction_grid(TString grid_definition)
+{
+  if (grid_definition == "") return get_default_fraction_grid();
+
+  vector<fraction_point> grid;
+  if (grid_definition.BeginsWith("simplex:")) {
+    TString settings = grid_definition(8, grid_definition.Length());
+    double step = atof(settings.Data());
+    double min_fraction = settings.Contains(":") ? atof(settings(settings.Index(":")+1, settings.Length()).Data()) : 0;
+    if (!(step > 0) || step > 1) { cout << "Bad grid " << grid_definition << ": the step has to be in (0, 1]" << endl; return grid; }
+    int n_steps = int(round(1/step));
+    if (fabs(n_steps*step - 1) > 1e-6) { cout << "Bad grid " << grid_definition << ": 1/step = " << 1/step << " is not an integer, the fractions wouldn't sum to one" << endl; return grid; }
+    if (min_fraction < 0 || 4*min_fraction > 1 + 1e-9) { cout << "Bad grid " << grid_definition << ": the minimum fraction has to be in [0, 0.25]" << endl; return grid; }
+    int min_steps = int(ceil(min_fraction/step - 1e-9));
+    for (int i=min_steps; i<=n_steps; i++) {
+      for (int j=min_steps; i+j<=n_steps; j++) {
+        for (int k=min_steps; i+j+k<=n_steps; k++) {
+          int l = n_steps - i - j - k;
+          if (l < min_steps) continue;
+          fraction_point point;
+          point.index = grid.size();
+          point.fractions[0] = i*step;
+          point.fractions[1] = j*step;
+          point.fractions[2] = k*step;
+          point.fractions[3] = l*step;
+          grid.push_back(point); } } }
+    return grid; }
+
+  ifstream grid_file(grid_definition.Data());
+  if (!grid_file.is_open()) { cout << "Can't open the grid " << grid_definition << endl; return grid; }
+  string line;
+  while (getline(grid_file, line)) {
+    if (line.empty() || line[0]=='#') continue;
+    istringstream columns(line);
+    fraction_point point;
+    point.index = grid.size();
+    if (columns >> point.fractions[0] >> point.fractions[1] >> point.fractions[2] >> point.fractions[3]) grid.push_back(point); }
+  return grid;
+}
+
+
+
+// ########################################
+// ## Fitted fractions of one grid point ##
+// ########################################
+struct template_fit_result
+{
+  int index = -1;
+  double true_fractions[n_processes] = {0, 0, 0, 0};
+  double fractions[3] = {0, 0, 0};   // 2b1l, 4b+3b, 2b1c
+  double errors[3] = {0, 0, 0};
+  int status = -1;
+  double chi2 = 0;
+  int ndf = 0;
+  TH1 *mixture = 0, *plot = 0;       // kept only when asked for, to draw them
+};
+
+
+
+// ###################################################################
+// ## Normalised templates as one contiguous [template][bin] matrix ##
+// ###################################################################
+//
+// Bins 1..n_bins of every template divided by its integral with the under
+// and overflow, as TH1::Scale(1/Integral(0, n_bins+1)) did. A mixture is
+// the product of the matrix with a vector of weights, written into a
+// buffer of the caller, so no histogram is booked or copied per mixture.
+// Combined templates are mixtures too, e.g. 4b+3b with the weights
+// {0, f_4b, f_3b, 0} or 2b1l+3b+2b1c with {f_2b1l, 0, f_3b, f_2b1c},
+// normalised.
+class template_matrix
+{
+public:
+  template_matrix(TH1 *const *hists, int n_templates)
+    : n_templates(n_templates), n_bins(hists[0]->GetNbinsX()), bins(n_templates*hists[0]->GetNbinsX(), 0)
+  {
+    for (int template_i=0; template_i<n_templates; template_i++) {
+      double integral = hists[template_i]->Integral(0, n_bins+1);
+      double *row = &bins[template_i*n_bins];
+      for (int bin_i=0; bin_i<n_bins; bin_i++) { row[bin_i] = integral > 0 ? hists[template_i]->GetBinContent(bin_i+1) / integral : 0; } }
+  }
+
+
+  // mixture[bin] = sum_j weights[j] template_j[bin], renormalised to unity
+  // over the bins if asked
+  void mix(const double *weights, double *mixture, bool normalise = false) const
+  {
+    for (int bin_i=0; bin_i<n_bins; bin_i++) { mixture[bin_i] = 0; }
+    for (int template_i=0; template_i<n_templates; template_i++) {
+      if (weights[template_i] == 0) continue;
+      const double *row = &bins[template_i*n_bins];
+      double weight = weights[template_i];
+      for (int bin_i=0; bin_i<n_bins; bin_i++) { mixture[bin_i] += weight * row[bin_i]; } }
+    if (!normalise) return;
+    double integral = 0;
+    for (int bin_i=0; bin_i<n_bins; bin_i++) { integral += mixture[bin_i]; }
+    if (integral > 0) for (int bin_i=0; bin_i<n_bins; bin_i++) { mixture[bin_i] /= integral; }
+  }
+
+
+  const double *row(int template_i) const { return &bins[template_i*n_bins]; }
+
+
+private:
+  int n_templates, n_bins;
+  vector<double> bins;   // [template][bin]
+};
+
+
+// Contents of a mixture into a histogram with the binning of the templates,
+// for plots and TFractionFitter
+void fill_hist(TH1 *hist, const double *contents)
+{
+  hist->Reset();
+  for (int bin_i=0; bin_i<hist->GetNbinsX(); bin_i++) { hist->SetBinContent(bin_i+1, contents[bin_i]); }
+}
+
+
+
+// #############################################################
+// ## Fitter of the 3rd tag mixtures, one instance per worker ##
+// #############################################################
+//
+// Fits a mixture of the four templates with three of them: 2b1l, the
+// combination of 4b and 3b in the ratio of the mixture, and 2b1c. The
+// mixture and the combined template are products of template_matrix with
+// the fractions of the point, into buffers allocated once per worker, and
+// go straight to binned_template_fitter. Every native fit starts from equal
+// fractions, not from the point the worker fitted before nor from the true
+// fractions, so the results don't depend on the number of workers or on
+// which worker got which point. Histograms are filled from the buffers only for
+// TFractionFitter, created and deleted for every point, and for plots.
+class template_fitter
+{
+public:
+  template_fitter(TH1 *const *process_templates, int worker_i = 0, bool native = true)
+    : native(native), templates(process_templates, n_processes), native_fitter(3, process_templates[0]->GetNbinsX()),
+      mixture(process_templates[0]->GetNbinsX(), 0), combined_4b_3b(process_templates[0]->GetNbinsX(), 0)
+  {
+    TString suffix = "_" + to_string(worker_i);
+    binning = (TH1D*)process_templates[0]->Clone("binning" + suffix);
+    binning->Reset();
+    native_fitter.set_template(0, templates.row(0));
+    native_fitter.set_template(2, templates.row(3));
+    for (int template_i=0; template_i<3; template_i++) { native_fitter.constrain(template_i, 0.0, 100.0); }
+
+    if (native) return;
+    mixture_hist = (TH1D*)binning->Clone("mixture" + suffix);
+    for (int template_i=0; template_i<3; template_i++) { fit_hists[template_i] = (TH1D*)binning->Clone(TString::Format("fit_template_%d", template_i) + suffix); }
+    fill_hist(fit_hists[0], templates.row(0));
+    fill_hist(fit_hists[2], templates.row(3));
+    fit_templates = new TObjArray(3);
+    for (int template_i=0; template_i<3; template_i++) { fit_templates->Add(fit_hists[template_i]); }
+  }
+
+
+  ~template_fitter()
+  {
+    delete binning;
+    if (native) return;
+    delete fit_templates;
+    delete mixture_hist;
+    for (int template_i=0; template_i<3; template_i++) { delete fit_hists[template_i]; }
+  }
+
+
+  template_fit_result fit(const fraction_point &point, bool keep_plots = false)
+  {
+    template_fit_result result;
+    result.index = point.index;
+    for (int process_i=0; process_i<n_processes; process_i++) { result.true_fractions[process_i] = point.fractions[process_i]; }
+
+    // Mixture of the four templates in the fractions of the point, and
+    // 4b+3b in the ratio of the mixture
+    templates.mix(point.fractions, &mixture[0]);
+    double weights_4b_3b[n_processes] = {0, point.fractions[1], point.fractions[2], 0};
+    templates.mix(weights_4b_3b, &combined_4b_3b[0], true);
+
+    if (native) return fit_native(result, keep_plots);
+
+    fill_hist(mixture_hist, &mixture[0]);
+    fill_hist(fit_hists[1], &combined_4b_3b[0]);
+    TFractionFitter *fitter = new TFractionFitter(mixture_hist, fit_templates, "Q");
+    for (int template_i=0; template_i<3; template_i++) { fitter->Constrain(template_i, 0.0, 100.0); }
+    result.status = fitter->Fit();
+    for (int template_i=0; template_i<3; template_i++) { fitter->GetResult(template_i, result.fractions[template_i], result.errors[template_i]); }
+    if (result.status==0) {
+      result.chi2 = fitter->GetChisquare();
+      result.ndf = fitter->GetNDF(); }
+
+    if (keep_plots) {
+      result.mixture = (TH1*)mixture_hist->Clone(TString::Format("mixture_%d", point.index));
+      if (result.status==0) result.plot = (TH1*)fitter->GetPlot()->Clone(TString::Format("fit_%d", point.index)); }
+    delete fitter;
+    return result;
+  }
+
+
+private:
+  template_fit_result fit_native(template_fit_result &result, bool keep_plots)
+  {
+    native_fitter.set_template(1, &combined_4b_3b[0]);
+    const double start[3] = {1./3, 1./3, 1./3};
+    native_fitter.start_from(start);
+    result.status = native_fitter.fit(&mixture[0]);
+    for (int template_i=0; template_i<3; template_i++) {
+      result.fractions[template_i] = native_fitter.fraction(template_i);
+      result.errors[template_i] = native_fitter.error(template_i); }
+    if (result.status==0) {
+      result.chi2 = native_fitter.chisquare();
+      result.ndf = native_fitter.ndf(); }
+
+    if (keep_plots) {
+      result.mixture = (TH1*)binning->Clone(TString::Format("mixture_%d", result.index));
+      fill_hist(result.mixture, &mixture[0]);
+      if (result.status==0) {
+        result.plot = (TH1*)binning->Clone(TString::Format("fit_%d", result.index));
+        native_fitter.fill_prediction(result.plot); } }
+    return result;
+  }
+
+  bool native;
+  template_matrix templates;
+  binned_template_fitter native_fitter;
+  vector<double> mixture, combined_4b_3b;   // [bin]
+  TH1D *binning;                            // empty, booked once for the plots
+  TH1D *mixture_hist = 0, *fit_hists[3] = {0, 0, 0};
+  TObjArray *fit_templates = 0;
+};
+
+
+
+// ###########################################
+// ## Results tree of a scan, in grid order ##
+// ###########################################
+void write_template_fit_results(const vector<template_fit_result> &results, TString results_path)
+{
+  TFile *results_file = new TFile(results_path, "RECREATE");
+  TTree *results_tree = new TTree("scan", "template fit scan");
+  template_fit_result result;
+  results_tree->Branch("index", &result.index, "index/I");
+  results_tree->Branch("true_fractions", result.true_fractions, "true_fractions[4]/D");
+  results_tree->Branch("fractions", result.fractions, "fractions[3]/D");
+  results_tree->Branch("errors", result.errors, "errors[3]/D");
+  results_tree->Branch("status", &result.status, "status/I");
+  results_tree->Branch("chi2", &result.chi2, "chi2/D");
+  results_tree->Branch("ndf", &result.ndf, "ndf/I");
+  for (int point_i=0; point_i<results.size(); point_i++) {
+    result = results[point_i];
+    results_tree->Fill(); }
+  results_tree->Write();
+  results_file->Close();
+  delete results_file;
+}
+
+#endif
@@ -0,0 +1,175 @@
+#ifndef TOY_ENGINE_H
+#define TOY_ENGINE_H
+
+#include <TH1.h>
+#include <TTree.h>
+#include <TFile.h>
+#include <TRandom3.h>
+#include <ROOT/TBufferMerger.hxx>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "template_fit_scan.h"
+#include "binned_template_fit.h"
+
+using namespace std;
+
+
+
+// ###########################################################
+// ## True fractions and size of the pseudo-data of a study ##
+// ###########################################################
+struct toy_config
+{
+  double fractions[n_processes];   // 2b1l, 4b, 3b, 2b1c
+  double n_events;                 // expected events of the pseudo-data
+};
+
+
+// One line per configuration: the four fractions and the expected events,
+// "#" lines are comments
+vector<toy_config> read_toy_configs(TString configs_path)
+{
+  vector<toy_config> configs;
+  ifstream configs_file(configs_path.Data());
+  if (!configs_file.is_open()) { cout << "Can't open " << configs_path << endl; return configs; }
+  string line;
+  while (getline(configs_file, line)) {
+    if (line.empty() || line[0]=='#') continue;
+    istringstream columns(line);
+    toy_config config;
+    if (columns >> config.fractions[0] >> config.fractions[1] >> config.fractions[2] >> config.fractions[3] >> config.n_events) configs.push_back(config); }
+  return configs;
+}
+
+
+
+// ##########################################
+// ## A block of toys of one configuration ##
+// ##########################################
+struct toy_block
+{
+  int config_i;
+  Long64_t first_toy, n_toys;
+  Long64_t size;   // cost for work_scheduler.h
+};
+
+
+vector<toy_block> get_toy_blocks(int n_configs, Long64_t n_toys, Long64_t toys_per_block)
+{
+  vector<toy_block> blocks;
+  for (int config_i=0; config_i<n_configs; config_i++) {
+    for (Long64_t first=0; first<n_toys; first+=toys_per_block) {
+      toy_block block;
+      block.config_i = config_i;
+      block.first_toy = first;
+      block.n_toys = min(toys_per_block, n_toys - first);
+      block.size = block.n_toys;
+      blocks.push_back(block); } }
+  return blocks;
+}
+
+
+
+// ######################################################################
+// ## Pseudo-experiments of one worker, fitted with the four templates ##
+// ######################################################################
+//
+// Every toy draws Poisson-fluctuated pseudo-data around the mixture of the
+// templates with the true fractions of its configuration, scaled to the
+// expected events, and fits it back with binned_template_fitter, each
+// fraction constrained to [0, 100]. The seed of a toy depends only on
+// its configuration and number, and every fit starts from the true
+// fractions, so results don't depend on the number of workers nor on the
+// toys a worker fitted before. Every worker streams its results to the merged file through a
+// TBufferMerger, handing its tree over every flush_entries toys.
+class toy_engine
+{
+public:
+  toy_engine(TH1 *const *process_templates, const vector<toy_config> &configs, ROOT::Experimental::TBufferMerger &merger, ULong64_t seed = 1, Long64_t flush_entries = 100000)
+    : configs(configs), seed(seed), flush_entries(flush_entries), n_bins(process_templates[0]->GetNbinsX()),
+      templates(process_templates, n_processes), fitter(n_processes, process_templates[0]->GetNbinsX()),
+      expected(process_templates[0]->GetNbinsX(), 0), pseudo_data(process_templates[0]->GetNbinsX(), 0)
+  {
+    for (int process_i=0; process_i<n_processes; process_i++) {
+      fitter.set_template(process_i, templates.row(process_i));
+      fitter.constrain(process_i, 0.0, 100.0); }
+
+    file = merger.GetFile();
+    tree = new TTree("toys", "template fit pseudo-experiments");
+    tree->SetDirectory(file.get());
+    tree->SetAutoFlush(flush_entries);
+    tree->Branch("config", &config_i, "config/I");
+    tree->Branch("toy", &toy_i, "toy/L");
+    tree->Branch("n_events", &n_events, "n_events/D");
+    tree->Branch("true_fractions", true_fractions, "true_fractions[4]/D");
+    tree->Branch("fractions", fractions, "fractions[4]/D");
+    tree->Branch("errors", errors, "errors[4]/D");
+    tree->Branch("status", &status, "status/I");
+  }
+
+
+  void run(const toy_block &block)
+  {
+    const toy_config &config = configs[block.config_i];
+    config_i = block.config_i;
+    n_events = config.n_events;
+    double weights[n_processes];
+    for (int process_i=0; process_i<n_processes; process_i++) {
+      true_fractions[process_i] = config.fractions[process_i];
+      weights[process_i] = config.n_events * config.fractions[process_i]; }
+
+    // Expected content of the pseudo-data, the same for all the toys of the block
+    templates.mix(weights, &expected[0]);
+
+    for (toy_i=block.first_toy; toy_i<block.first_toy+block.n_toys; toy_i++) {
+      random.SetSeed(seed + ULong64_t(config_i)*1000000007ULL + ULong64_t(toy_i)*2654435761ULL);
+      for (int bin_i=0; bin_i<n_bins; bin_i++) { pseudo_data[bin_i] = random.Poisson(expected[bin_i]); }
+
+      fitter.start_from(true_fractions);
+      status = fitter.fit(&pseudo_data[0]);
+      for (int process_i=0; process_i<n_processes; process_i++) {
+        fractions[process_i] = fitter.fraction(process_i);
+        errors[process_i] = fitter.error(process_i); }
+      tree->Fill();
+      n_done++;
+      if (++pending >= flush_entries) write(); }
+  }
+
+
+  // Hand the toys filled so far to the merger
+  void write()
+  {
+    if (pending == 0) return;
+    file->Write();
+    pending = 0;
+  }
+
+
+  Long64_t toys_done() const { return n_done; }
+
+
+private:
+  const vector<toy_config> &configs;
+  ULong64_t seed;
+  Long64_t flush_entries, pending = 0, n_done = 0;
+  int n_bins;
+  template_matrix templates;
+  binned_template_fitter fitter;
+  vector<double> expected, pseudo_data;   // [bin]
+  TRandom3 random;
+
+  shared_ptr<ROOT::Experimental::TBufferMergerFile> file;
+  TTree *tree;
+  int config_i = 0, status = 0;
+  Long64_t toy_i = 0;
+  double n_events = 0;
+  double true_fractions[n_processes], fractions[n_processes], errors[n_processes];
+};
+
+#endif
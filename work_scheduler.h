@@ -0,0 +1,81 @@
+#ifndef WORK_SCHEDULER_H
+#define WORK_SCHEDULER_H
+
+#include <Rtypes.h>
+
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+
+
+// ##############################################################
+// ## Size-aware work-stealing scheduler for a pool of workers ##
+// ##############################################################
+//
+// unit_t is any unit of work with a `size` member (e.g. compressed bytes
+// of a file or of a range of its entries). The units are sorted largest
+// first and dealt to the worker queues so that every queue gets about the
+// same total size. A worker takes units from its own queue and, once it
+// is empty, steals the largest unit left in the most loaded queue. Big
+// units thus start early and small ones fill the gaps at the end.
+template <typename unit_t>
+class work_scheduler
+{
+public:
+  work_scheduler(vector<unit_t> units, int n_workers)
+    : queues(n_workers), queue_sizes(n_workers, 0), queue_mutexes(n_workers), n_stolen(n_workers, 0)
+  {
+    stable_sort(units.begin(), units.end(), [](const unit_t &a, const unit_t &b) { return a.size > b.size; });
+    for (int unit_i=0; unit_i<units.size(); unit_i++) {
+      int lightest = min_element(queue_sizes.begin(), queue_sizes.end()) - queue_sizes.begin();
+      queues[lightest].push_back(units[unit_i]);
+      queue_sizes[lightest] += units[unit_i].size; }
+  }
+
+
+  // Get the next unit for the given worker, false once everything is done
+  bool next(int worker_i, unit_t &unit)
+  {
+    if (pop(worker_i, worker_i, unit)) return true;
+
+    // Own queue is empty: steal from the most loaded one
+    while (true) {
+      int victim = -1;
+      Long64_t victim_size = 0;
+      for (int queue_i=0; queue_i<queues.size(); queue_i++) {
+        lock_guard<mutex> lock(queue_mutexes[queue_i]);
+        if (!queues[queue_i].empty() && queue_sizes[queue_i] >= victim_size) {
+          victim = queue_i;
+          victim_size = queue_sizes[queue_i]; } }
+      if (victim < 0) return false;
+      if (pop(victim, worker_i, unit)) return true; }
+  }
+
+
+  // Number of units a worker took from the other queues
+  int stolen(int worker_i) const { return n_stolen[worker_i]; }
+
+
+private:
+  bool pop(int queue_i, int worker_i, unit_t &unit)
+  {
+    lock_guard<mutex> lock(queue_mutexes[queue_i]);
+    if (queues[queue_i].empty()) return false;
+    unit = queues[queue_i].front();
+    queues[queue_i].pop_front();
+    queue_sizes[queue_i] -= unit.size;
+    if (queue_i != worker_i) n_stolen[worker_i]++; // only touched by its own worker
+    return true;
+  }
+
+  vector<deque<unit_t>> queues;
+  vector<Long64_t> queue_sizes;
+  vector<mutex> queue_mutexes;
+  vector<int> n_stolen;
+};
+
+#endif